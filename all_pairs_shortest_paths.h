@@ -0,0 +1,425 @@
+//
+// Shortest paths between every pair of nodes.
+//
+#pragma once
+
+#include "bellman_ford.h"
+#include "graph_common.h"
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+
+class distance_matrix;
+
+// Distances between every pair of nodes by the Floyd-Warshall algorithm, for
+// a weighted_directed_graph, a directed_graph or a compressed_graph. Edge
+// weights may be negative. With next_hops, the first step of each shortest
+// path is recorded as well, so that paths can be rebuilt; paths of equal
+// weight are then told apart by their numbers of edges, so that following
+// next hops can't go round a cycle of zero-weight edges. The matrix takes
+// 8 bytes per pair of nodes, and next hops 8 more, so this is meant for
+// graphs of up to some tens of thousands of nodes.
+//
+// The matrix is split into square tiles that fit in the cache, and each
+// pass of the algorithm updates the tile on the diagonal first, then the
+// tiles in its row and column, and then all the others, which are
+// independent of one another and are spread over pool. The inner loop takes
+// the minimum of two rows of a tile with no branches, which compilers
+// vectorise.
+template<typename Graph>
+[[nodiscard]] distance_matrix
+floyd_warshall(const Graph& graph, bool next_hops = false,
+               thread_pool& pool = default_thread_pool());
+
+// Shortest paths from every node, or from each of sources, by Johnson's
+// algorithm, for a weighted_directed_graph, a directed_graph or a
+// compressed_graph. Edge weights may be negative. For each source, calls
+// fn(source, distances) with the distances from source to every node, in
+// a span that is only valid during the call, so the whole matrix is never
+// held at once. Calls are made from pool's workers, in no particular order
+// and possibly at the same time. Returns false, without calling fn, if the
+// graph has a negative cycle or any of sources is out of range.
+//
+// A Bellman-Ford pass first finds a potential for each node that makes
+// every edge's weight, plus the potential of its source and less that of
+// its target, non-negative. Dijkstra's algorithm is then run from each
+// source with those weights, which are worked out as edges are scanned,
+// and the potentials are taken back off the results. Each worker keeps its
+// own search arrays for all the sources it handles. On sparse graphs this
+// does far less work than floyd_warshall.
+template<typename Graph, typename F>
+bool johnson(const Graph& graph, F&& fn,
+             thread_pool& pool = default_thread_pool());
+
+template<typename Graph, typename F>
+bool johnson(const Graph& graph, std::span<const std::size_t> sources, F&& fn,
+             thread_pool& pool = default_thread_pool());
+
+// Distances between every pair of nodes of a graph, with infinity for pairs
+// with no path. If the graph has a negative cycle, has_negative_cycle() is
+// true and the distances of pairs with a path through one are meaningless.
+class distance_matrix {
+public:
+    using size_type = std::size_t;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    distance_matrix() = default;
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] double distance(size_type from, size_type to) const;
+
+    // Distances from `from` to every node
+    [[nodiscard]] std::span<const double> row(size_type from) const;
+
+    [[nodiscard]] bool has_negative_cycle() const;
+
+    // True if next hops were recorded
+    [[nodiscard]] bool has_next_hops() const noexcept;
+
+    // The node after `from` on a shortest path to `to`, or npos if there is
+    // none, or next hops weren't recorded
+    [[nodiscard]] size_type next_hop(size_type from, size_type to) const;
+
+    // The nodes on a shortest path from `from` to `to`, or nothing if there
+    // is none, or next hops weren't recorded
+    [[nodiscard]] std::vector<size_type> path(size_type from,
+                                              size_type to) const;
+
+private:
+    template<typename Graph>
+    friend distance_matrix floyd_warshall(const Graph& graph, bool next_hops,
+                                          thread_pool& pool);
+
+    // Nodes per side of a tile, and the row length of the matrices, which
+    // are padded out to whole tiles
+    static constexpr size_type tile_size{ 64 };
+    static constexpr std::uint32_t no_hop{ static_cast<std::uint32_t>(-1) };
+
+    size_type m_size{ 0 };
+    size_type m_stride{ 0 };
+    std::vector<double> m_distances;
+    std::vector<std::uint32_t> m_nextHops;
+    // Number of edges on the path each next hop starts, or zero if there
+    // is none
+    std::vector<std::uint32_t> m_edgeCounts;
+
+    // Floyd-Warshall steps over a tile: lowers each entry (i, j) of the
+    // tile at `to` to the distance through each k of the tile's columns in
+    // `via`, where the tile at `from` holds the distances (k, j). With
+    // Overlapping, `to` may be the same tile as either of the others.
+    template<bool NextHops, bool Overlapping>
+    void relax_tile(size_type to, size_type via, size_type from);
+};
+
+template<typename Graph>
+distance_matrix floyd_warshall(const Graph& graph, bool next_hops,
+                               thread_pool& pool) {
+    using size_type = distance_matrix::size_type;
+    constexpr auto tile_size{ distance_matrix::tile_size };
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    const auto n{ graph.size() };
+    const auto tiles{ (n + tile_size - 1) / tile_size };
+    distance_matrix matrix;
+    matrix.m_size = n;
+    matrix.m_stride = tiles * tile_size;
+    const auto stride{ matrix.m_stride };
+    matrix.m_distances.assign(stride * stride, infinity);
+    if (next_hops) {
+        matrix.m_nextHops.assign(stride * stride, distance_matrix::no_hop);
+        matrix.m_edgeCounts.assign(stride * stride, 0);
+    }
+
+    pool.parallel_for(
+        0, n,
+        [&](size_type from) {
+            auto* distances{ matrix.m_distances.data() + from * stride };
+            auto* hops{ next_hops ? matrix.m_nextHops.data() + from * stride
+                                  : nullptr };
+            auto* counts{ next_hops ? matrix.m_edgeCounts.data() +
+                                          from * stride
+                                    : nullptr };
+            distances[from] = 0;
+            if (hops) { hops[from] = static_cast<std::uint32_t>(from); }
+            details::for_each_weighted_edge(
+                graph, from, [&](size_type to, double weight) {
+                    if (!(weight < distances[to])) { return; }
+                    distances[to] = weight;
+                    if (hops) {
+                        hops[to] = static_cast<std::uint32_t>(to);
+                        counts[to] = 1;
+                    }
+                });
+        },
+        64);
+
+    const auto relax{ [&](size_type to, size_type via, size_type from) {
+        const auto overlapping{ to == via || to == from };
+        if (next_hops) {
+            if (overlapping) {
+                matrix.template relax_tile<true, true>(to, via, from);
+            } else {
+                matrix.template relax_tile<true, false>(to, via, from);
+            }
+        } else {
+            if (overlapping) {
+                matrix.template relax_tile<false, true>(to, via, from);
+            } else {
+                matrix.template relax_tile<false, false>(to, via, from);
+            }
+        }
+    } };
+    const auto tile{ [&](size_type row, size_type column) {
+        return (row * stride + column) * tile_size;
+    } };
+    for (size_type k{ 0 }; k < tiles; ++k) {
+        const auto diagonal{ tile(k, k) };
+        relax(diagonal, diagonal, diagonal);
+        // The rest of row k and column k only depend on the diagonal tile
+        pool.parallel_for(
+            0, 2 * tiles,
+            [&](size_type i) {
+                const auto other{ i / 2 };
+                if (other == k) { return; }
+                if (i % 2 == 0) {
+                    const auto in_row{ tile(k, other) };
+                    relax(in_row, diagonal, in_row);
+                } else {
+                    const auto in_column{ tile(other, k) };
+                    relax(in_column, in_column, diagonal);
+                }
+            },
+            1);
+        // and the other tiles only on those
+        pool.parallel_for(
+            0, tiles * tiles,
+            [&](size_type i) {
+                const auto row{ i / tiles };
+                const auto column{ i % tiles };
+                if (row == k || column == k) { return; }
+                relax(tile(row, column), tile(row, k), tile(k, column));
+            },
+            1);
+    }
+    return matrix;
+}
+
+template<bool NextHops, bool Overlapping>
+void distance_matrix::relax_tile(size_type to, size_type via,
+                                 size_type from) {
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    auto* distances{ m_distances.data() };
+    auto* hops{ m_nextHops.data() };
+    auto* counts{ m_edgeCounts.data() };
+    // With next hops, a path replaces one of equal weight if it has fewer
+    // edges. Pairs with no path have an infinite weight and no edges, so no
+    // candidate, which is then also infinite, ties with them.
+    if constexpr (Overlapping) {
+        // Each step must see the last one's changes to the other tiles, so
+        // the steps are the outer loop
+        for (size_type k{ 0 }; k < tile_size; ++k) {
+            const auto* from_k{ distances + from + k * m_stride };
+            for (size_type i{ 0 }; i < tile_size; ++i) {
+                const auto via_ik{ distances[via + i * m_stride + k] };
+                if (via_ik == infinity) { continue; }
+                auto* to_i{ distances + to + i * m_stride };
+                if constexpr (NextHops) {
+                    const auto hop{ hops[via + i * m_stride + k] };
+                    const auto count_ik{ counts[via + i * m_stride + k] };
+                    const auto* counts_k{ counts + from + k * m_stride };
+                    auto* hops_i{ hops + to + i * m_stride };
+                    auto* counts_i{ counts + to + i * m_stride };
+                    for (size_type j{ 0 }; j < tile_size; ++j) {
+                        const auto candidate{ via_ik + from_k[j] };
+                        const auto count{ count_ik + counts_k[j] };
+                        const auto shorter{ candidate < to_i[j] ||
+                                            (candidate == to_i[j] &&
+                                             count < counts_i[j]) };
+                        to_i[j] = shorter ? candidate : to_i[j];
+                        hops_i[j] = shorter ? hop : hops_i[j];
+                        counts_i[j] = shorter ? count : counts_i[j];
+                    }
+                } else {
+                    for (size_type j{ 0 }; j < tile_size; ++j) {
+                        to_i[j] = std::min(to_i[j], via_ik + from_k[j]);
+                    }
+                }
+            }
+        }
+    } else {
+        // Each row of the tile is lowered in a local copy, which the
+        // compiler knows nothing else can alias, so that the inner loop is
+        // vectorised
+        std::array<double, tile_size> row;
+        std::array<std::uint32_t, tile_size> row_hops;
+        std::array<std::uint32_t, tile_size> row_counts;
+        for (size_type i{ 0 }; i < tile_size; ++i) {
+            auto* to_i{ distances + to + i * m_stride };
+            std::copy_n(to_i, tile_size, row.data());
+            if constexpr (NextHops) {
+                std::copy_n(hops + to + i * m_stride, tile_size,
+                            row_hops.data());
+                std::copy_n(counts + to + i * m_stride, tile_size,
+                            row_counts.data());
+            }
+            for (size_type k{ 0 }; k < tile_size; ++k) {
+                const auto via_ik{ distances[via + i * m_stride + k] };
+                if (via_ik == infinity) { continue; }
+                const auto* from_k{ distances + from + k * m_stride };
+                if constexpr (NextHops) {
+                    const auto hop{ hops[via + i * m_stride + k] };
+                    const auto count_ik{ counts[via + i * m_stride + k] };
+                    const auto* counts_k{ counts + from + k * m_stride };
+                    for (size_type j{ 0 }; j < tile_size; ++j) {
+                        const auto candidate{ via_ik + from_k[j] };
+                        const auto count{ count_ik + counts_k[j] };
+                        const auto shorter{ candidate < row[j] ||
+                                            (candidate == row[j] &&
+                                             count < row_counts[j]) };
+                        row[j] = shorter ? candidate : row[j];
+                        row_hops[j] = shorter ? hop : row_hops[j];
+                        row_counts[j] = shorter ? count : row_counts[j];
+                    }
+                } else {
+                    for (size_type j{ 0 }; j < tile_size; ++j) {
+                        row[j] = std::min(row[j], via_ik + from_k[j]);
+                    }
+                }
+            }
+            std::copy_n(row.data(), tile_size, to_i);
+            if constexpr (NextHops) {
+                std::copy_n(row_hops.data(), tile_size,
+                            hops + to + i * m_stride);
+                std::copy_n(row_counts.data(), tile_size,
+                            counts + to + i * m_stride);
+            }
+        }
+    }
+}
+
+inline distance_matrix::size_type distance_matrix::size() const noexcept {
+    return m_size;
+}
+
+inline double distance_matrix::distance(size_type from, size_type to) const {
+    return m_distances[from * m_stride + to];
+}
+
+inline std::span<const double> distance_matrix::row(size_type from) const {
+    return { m_distances.data() + from * m_stride, m_size };
+}
+
+inline bool distance_matrix::has_negative_cycle() const {
+    for (size_type node{ 0 }; node < m_size; ++node) {
+        if (distance(node, node) < 0) { return true; }
+    }
+    return false;
+}
+
+inline bool distance_matrix::has_next_hops() const noexcept {
+    return !m_nextHops.empty();
+}
+
+inline distance_matrix::size_type
+distance_matrix::next_hop(size_type from, size_type to) const {
+    if (!has_next_hops()) { return npos; }
+    const auto hop{ m_nextHops[from * m_stride + to] };
+    return hop == no_hop ? npos : hop;
+}
+
+inline std::vector<distance_matrix::size_type>
+distance_matrix::path(size_type from, size_type to) const {
+    std::vector<size_type> nodes;
+    if (next_hop(from, to) == npos) { return nodes; }
+    nodes.push_back(from);
+    // A path through a negative cycle could go round it for ever, so give
+    // up once it is longer than any simple path
+    while (from != to && nodes.size() <= m_size) {
+        from = next_hop(from, to);
+        nodes.push_back(from);
+    }
+    if (from != to) { nodes.clear(); }
+    return nodes;
+}
+
+template<typename Graph, typename F>
+bool johnson(const Graph& graph, F&& fn, thread_pool& pool) {
+    std::vector<std::size_t> sources(graph.size());
+    for (std::size_t node{ 0 }; node < sources.size(); ++node) {
+        sources[node] = node;
+    }
+    return johnson(graph, std::span<const std::size_t>{ sources },
+                   std::forward<F>(fn), pool);
+}
+
+template<typename Graph, typename F>
+bool johnson(const Graph& graph, std::span<const std::size_t> sources, F&& fn,
+             thread_pool& pool) {
+    using size_type = std::size_t;
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    const auto n{ graph.size() };
+    if (std::any_of(std::begin(sources), std::end(sources),
+                    [n](size_type source) { return source >= n; })) {
+        return false;
+    }
+
+    // The potentials are the distances from a notional node with an edge
+    // of weight zero to every node
+    bellman_ford_result potentials{ std::vector<double>(n, 0),
+                                    std::vector<size_type>(n), {} };
+    std::vector<size_type> all_nodes(n);
+    for (size_type node{ 0 }; node < n; ++node) {
+        all_nodes[node] = node;
+        potentials.parents[node] = node;
+    }
+    details::bellman_ford(graph, all_nodes, bellman_ford_mode::rounds, pool,
+                          potentials);
+    if (!potentials.negative_cycle.empty()) { return false; }
+    const auto& potential{ potentials.distances };
+
+    std::vector<details::dijkstra_state> states(pool.size());
+    std::vector<std::vector<double>> rows(pool.size());
+    pool.parallel_for_chunks(
+        0, sources.size(),
+        [&](size_type worker, size_type first, size_type last) {
+            auto& state{ states[worker] };
+            auto& row{ rows[worker] };
+            row.resize(n);
+            for (auto i{ first }; i < last; ++i) {
+                const auto source{ sources[i] };
+                state.reset(n);
+                state.relax(source, 0, source);
+                while (!state.heap.empty()) {
+                    const auto node{ state.heap.top() };
+                    const auto distance{ state.heap.top_key() };
+                    state.heap.pop();
+                    details::for_each_weighted_edge(
+                        graph, node, [&](size_type to, double weight) {
+                            // Rounding can leave a reweighted edge just
+                            // below zero
+                            const auto reweighted{ std::max(
+                                0.0,
+                                weight + potential[node] - potential[to]) };
+                            state.relax(to, distance + reweighted, node);
+                        });
+                }
+                std::fill(std::begin(row), std::end(row), infinity);
+                for (auto node: state.touched) {
+                    row[node] = state.distances[node] - potential[source] +
+                                potential[node];
+                }
+                fn(source, std::span<const double>{ row });
+            }
+        },
+        1);
+    return true;
+}
@@ -0,0 +1,266 @@
+//
+// Shortest paths with negative edge weights, and negative cycle detection.
+//
+#pragma once
+
+#include "graph_common.h"
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// How bellman_ford works through the edges. In rounds, the edges out of
+// every node whose distance dropped in the last round are relaxed together,
+// in parallel. With queue, the SPFA variant, nodes whose distances drop are
+// queued and have their edges relaxed one at a time, on the calling thread,
+// which often does less work in total but can't be spread out.
+enum class bellman_ford_mode { rounds, queue };
+
+// Result of bellman_ford. If the source can reach a negative cycle,
+// negative_cycle holds its nodes in order, each with an edge to the next
+// and the last with one back to the first, and the distances and parents
+// are left as they were when it was found. Otherwise negative_cycle is
+// empty, and distances and parents are as in sssp_result.
+struct bellman_ford_result {
+    std::vector<double> distances;
+    std::vector<std::size_t> parents;
+    std::vector<std::size_t> negative_cycle;
+};
+
+// Shortest paths from source by the Bellman-Ford algorithm, for a
+// weighted_directed_graph, a directed_graph or a compressed_graph. Unlike
+// dijkstra, edge weights may be negative.
+//
+// Only the edges out of nodes whose distances have dropped are relaxed
+// again, and the search stops as soon as none have. Negative cycles are
+// found by looking for a cycle among the parent links, which any negative
+// cycle the source can reach eventually forms and which can't form
+// otherwise. That look takes time in proportion to the number of nodes, so
+// it is only taken after as many relaxations have succeeded, which keeps
+// its cost within that of the search and finds most cycles long before the
+// textbook bound of a pass per node.
+template<typename Graph>
+[[nodiscard]] bellman_ford_result
+bellman_ford(const Graph& graph, node_id source,
+             bellman_ford_mode mode = bellman_ford_mode::rounds,
+             thread_pool& pool = default_thread_pool());
+
+// A negative cycle anywhere in graph, as its nodes in order, or nothing if
+// it has none. This is bellman_ford from a notional source with an edge of
+// weight zero to every node.
+template<typename Graph>
+[[nodiscard]] std::vector<std::size_t>
+find_negative_cycle(const Graph& graph,
+                    bellman_ford_mode mode = bellman_ford_mode::rounds,
+                    thread_pool& pool = default_thread_pool());
+
+namespace details {
+    // A cycle among parent links, as its nodes in the order of the edges
+    // they stand for, or nothing. Nodes that are their own parents, or have
+    // none, are roots.
+    inline std::vector<std::size_t>
+    find_parent_cycle(const std::vector<std::size_t>& parents) {
+        constexpr auto npos{ dijkstra_state::npos };
+        enum : char { unvisited, on_walk, done };
+        const auto n{ parents.size() };
+        std::vector<char> states(n, unvisited);
+        std::vector<std::size_t> cycle;
+        for (std::size_t start{ 0 }; start < n; ++start) {
+            // Walk up from start until reaching a root, a node an earlier
+            // walk covered, or a node this walk has already passed
+            auto node{ start };
+            while (states[node] == unvisited) {
+                states[node] = on_walk;
+                const auto parent{ parents[node] };
+                if (parent == npos || parent == node) { break; }
+                node = parent;
+            }
+            if (states[node] == on_walk && parents[node] != npos &&
+                parents[node] != node) {
+                const auto first{ node };
+                do {
+                    cycle.push_back(node);
+                    node = parents[node];
+                } while (node != first);
+                std::reverse(std::begin(cycle), std::end(cycle));
+                return cycle;
+            }
+            for (node = start; node != npos && states[node] == on_walk;
+                 node = parents[node]) {
+                states[node] = done;
+            }
+        }
+        return cycle;
+    }
+
+    // Bellman-Ford from every node in sources at once, each at distance
+    // zero. result's arrays must be sized for the graph, with the sources
+    // already at distance zero and as their own parents.
+    template<typename Graph>
+    void bellman_ford(const Graph& graph,
+                      const std::vector<std::size_t>& sources,
+                      bellman_ford_mode mode, thread_pool& pool,
+                      bellman_ford_result& result) {
+        using size_type = std::size_t;
+        const auto n{ graph.size() };
+        auto& distances{ result.distances };
+        auto& parents{ result.parents };
+        constexpr auto npos{ dijkstra_state::npos };
+        // Successful relaxations since the parent links were last checked
+        size_type relaxations{ 0 };
+        auto check_parents{ [&] {
+            if (relaxations < n) { return false; }
+            relaxations = 0;
+            result.negative_cycle = find_parent_cycle(parents);
+            return !result.negative_cycle.empty();
+        } };
+        // A node with a negative edge to itself is a negative cycle the
+        // parent links can't show, since a node that is its own parent is
+        // a root
+        auto found_loop{ [&](size_type node) {
+            if (node == npos) { return false; }
+            result.negative_cycle = { node };
+            return true;
+        } };
+
+        if (mode == bellman_ford_mode::queue) {
+            std::deque<size_type> queue(std::begin(sources),
+                                        std::end(sources));
+            std::vector<char> queued(n, 0);
+            for (auto node: sources) { queued[node] = 1; }
+            while (!queue.empty()) {
+                const auto node{ queue.front() };
+                queue.pop_front();
+                queued[node] = 0;
+                const auto distance{ distances[node] };
+                auto loop{ npos };
+                for_each_weighted_edge(
+                    graph, node, [&](size_type to, double weight) {
+                        if (to == node) {
+                            if (weight < 0) { loop = node; }
+                            return;
+                        }
+                        if (!(distance + weight < distances[to])) { return; }
+                        distances[to] = distance + weight;
+                        parents[to] = node;
+                        ++relaxations;
+                        if (!queued[to]) {
+                            queued[to] = 1;
+                            queue.push_back(to);
+                        }
+                    });
+                if (found_loop(loop) || check_parents()) { return; }
+            }
+            return;
+        }
+
+        // Each worker records the relaxations it wins as (node, distance,
+        // parent), and the nodes it is first to claim for the next round.
+        // Parents are set from the records after the round, to whichever
+        // recorded parent gave a node its final distance, since setting
+        // them as distances fall could pair a distance with the wrong
+        // parent when two threads lower the same node.
+        struct relaxation {
+            size_type node;
+            double distance;
+            size_type parent;
+        };
+        std::vector<std::vector<relaxation>> relaxed(pool.size());
+        std::vector<std::vector<size_type>> claimed(pool.size());
+        std::vector<size_type> loops(pool.size(), npos);
+        std::vector<char> in_next(n, 0);
+        std::vector<size_type> frontier{ sources };
+        while (!frontier.empty()) {
+            pool.parallel_for_chunks(
+                0, frontier.size(),
+                [&](size_type worker, size_type first, size_type last) {
+                    for (auto i{ first }; i < last; ++i) {
+                        const auto node{ frontier[i] };
+                        const auto distance{
+                            std::atomic_ref{ distances[node] }.load(
+                                std::memory_order_relaxed) };
+                        for_each_weighted_edge(
+                            graph, node, [&](size_type to, double weight) {
+                                if (to == node) {
+                                    if (weight < 0) { loops[worker] = node; }
+                                    return;
+                                }
+                                const auto candidate{ distance + weight };
+                                if (!atomic_lower(distances[to], candidate)) {
+                                    return;
+                                }
+                                relaxed[worker].push_back(
+                                    { to, candidate, node });
+                                if (!std::atomic_ref{ in_next[to] }.exchange(
+                                        1, std::memory_order_relaxed)) {
+                                    claimed[worker].push_back(to);
+                                }
+                            });
+                    }
+                },
+                64);
+            pool.parallel_for(
+                0, pool.size(),
+                [&](size_type worker) {
+                    for (const auto& entry: relaxed[worker]) {
+                        if (entry.distance == distances[entry.node]) {
+                            std::atomic_ref{ parents[entry.node] }.store(
+                                entry.parent, std::memory_order_relaxed);
+                        }
+                    }
+                },
+                1);
+
+            frontier.clear();
+            for (size_type worker{ 0 }; worker < pool.size(); ++worker) {
+                if (found_loop(loops[worker])) { return; }
+                relaxations += relaxed[worker].size();
+                relaxed[worker].clear();
+                frontier.insert(std::end(frontier),
+                                std::begin(claimed[worker]),
+                                std::end(claimed[worker]));
+                claimed[worker].clear();
+            }
+            for (auto node: frontier) { in_next[node] = 0; }
+            if (check_parents()) { return; }
+        }
+    }
+}// namespace details
+
+template<typename Graph>
+bellman_ford_result bellman_ford(const Graph& graph, node_id source,
+                                 bellman_ford_mode mode, thread_pool& pool) {
+    const auto n{ graph.size() };
+    bellman_ford_result result{
+        std::vector<double>(n, std::numeric_limits<double>::infinity()),
+        std::vector<std::size_t>(n, details::dijkstra_state::npos),
+        {}
+    };
+    if (source.index >= n) { return result; }
+    result.distances[source.index] = 0;
+    result.parents[source.index] = source.index;
+    details::bellman_ford(graph, { source.index }, mode, pool, result);
+    return result;
+}
+
+template<typename Graph>
+std::vector<std::size_t> find_negative_cycle(const Graph& graph,
+                                             bellman_ford_mode mode,
+                                             thread_pool& pool) {
+    const auto n{ graph.size() };
+    bellman_ford_result result{ std::vector<double>(n, 0),
+                                std::vector<std::size_t>(n), {} };
+    std::vector<std::size_t> sources(n);
+    for (std::size_t node{ 0 }; node < n; ++node) {
+        sources[node] = node;
+        result.parents[node] = node;
+    }
+    details::bellman_ford(graph, sources, mode, pool, result);
+    return std::move(result.negative_cycle);
+}
@@ -0,0 +1,193 @@
+//
+// A compressed sparse row copy of a graph, for algorithms that scan edges.
+//
+#pragma once
+
+#include "graph_common.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A read-only copy of a graph's edges in compressed sparse row form: the
+// out-edges of each node, and its in-edges, are stored contiguously in flat
+// arrays. Algorithms that scan many edges run much faster over this than
+// over the graphs' per-node sets, and the in-edges make backward searches
+// possible. Node indices are those of the graph the copy was made from, and
+// edge weights are kept when it is a weighted graph.
+class compressed_graph {
+public:
+    using size_type = std::size_t;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    compressed_graph() = default;
+
+    // Copies graph, which must not be modified while this runs. Nodes are
+    // copied in parallel on pool.
+    template<typename Graph>
+    explicit compressed_graph(const Graph& graph,
+                              thread_pool& pool = default_thread_pool());
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] size_type edge_count() const noexcept;
+
+    // True if the graph was copied from a weighted graph
+    [[nodiscard]] bool weighted() const noexcept;
+
+    // Targets of the edges out of node, in ascending order
+    [[nodiscard]] std::span<const size_type> out_edges(size_type node) const;
+
+    // Sources of the edges into node, in ascending order
+    [[nodiscard]] std::span<const size_type> in_edges(size_type node) const;
+
+    // Weights of the edges in out_edges(node) and in_edges(node), in the
+    // same order. Empty if the graph is not weighted.
+    [[nodiscard]] std::span<const double> out_weights(size_type node) const;
+
+    [[nodiscard]] std::span<const double> in_weights(size_type node) const;
+
+    [[nodiscard]] size_type out_degree(size_type node) const;
+
+    [[nodiscard]] size_type in_degree(size_type node) const;
+
+private:
+    std::vector<size_type> m_outOffsets{ 0 };
+    std::vector<size_type> m_outTargets;
+    std::vector<double> m_outWeights;
+
+    std::vector<size_type> m_inOffsets{ 0 };
+    std::vector<size_type> m_inSources;
+    std::vector<double> m_inWeights;
+
+    bool m_weighted{ false };
+};
+
+template<typename Graph>
+compressed_graph::compressed_graph(const Graph& graph, thread_pool& pool) {
+    using edge_type =
+        std::remove_cvref_t<decltype(*std::begin(graph.out_edges(0)))>;
+    constexpr bool is_weighted{ details::weighted_edge<edge_type> };
+    const auto n{ graph.size() };
+
+    // The graphs store both degrees, so the layout is known up front
+    m_outOffsets.assign(n + 1, 0);
+    m_inOffsets.assign(n + 1, 0);
+    for (size_type node{ 0 }; node < n; ++node) {
+        m_outOffsets[node + 1] =
+            m_outOffsets[node] + graph.out_degree(node_id{ node });
+        m_inOffsets[node + 1] =
+            m_inOffsets[node] + graph.in_degree(node_id{ node });
+    }
+    m_outTargets.resize(m_outOffsets[n]);
+    m_inSources.resize(m_inOffsets[n]);
+    if constexpr (is_weighted) {
+        m_weighted = true;
+        m_outWeights.resize(m_outOffsets[n]);
+        m_inWeights.resize(m_inOffsets[n]);
+    }
+
+    // Copy the out-edges, and scatter each one to its target's in-edges
+    std::vector<std::atomic<size_type>> cursors(n);
+    for (size_type node{ 0 }; node < n; ++node) {
+        cursors[node].store(m_inOffsets[node], std::memory_order_relaxed);
+    }
+    pool.parallel_for(
+        0, n,
+        [&](size_type from) {
+            auto position{ m_outOffsets[from] };
+            for (auto&& edge: graph.out_edges(from)) {
+                const auto to{ details::edge_target(edge) };
+                const auto in_position{ cursors[to].fetch_add(
+                    1, std::memory_order_relaxed) };
+                m_outTargets[position] = to;
+                m_inSources[in_position] = from;
+                if constexpr (is_weighted) {
+                    m_outWeights[position] = edge.weight();
+                    m_inWeights[in_position] = edge.weight();
+                }
+                ++position;
+            }
+        },
+        256);
+
+    // The scatter leaves in-edges in whatever order the workers got to
+    // them, so sort them for a deterministic layout
+    pool.parallel_for(
+        0, n,
+        [&](size_type to) {
+            const auto first{ m_inOffsets[to] };
+            const auto last{ m_inOffsets[to + 1] };
+            if constexpr (is_weighted) {
+                std::vector<std::pair<size_type, double>> edges;
+                edges.reserve(last - first);
+                for (auto i{ first }; i < last; ++i) {
+                    edges.emplace_back(m_inSources[i], m_inWeights[i]);
+                }
+                std::sort(std::begin(edges), std::end(edges));
+                for (auto i{ first }; i < last; ++i) {
+                    m_inSources[i] = edges[i - first].first;
+                    m_inWeights[i] = edges[i - first].second;
+                }
+            } else {
+                std::sort(std::begin(m_inSources) + first,
+                          std::begin(m_inSources) + last);
+            }
+        },
+        256);
+}
+
+inline compressed_graph::size_type compressed_graph::size() const noexcept {
+    return m_outOffsets.size() - 1;
+}
+
+inline compressed_graph::size_type
+compressed_graph::edge_count() const noexcept {
+    return m_outTargets.size();
+}
+
+inline bool compressed_graph::weighted() const noexcept {
+    return m_weighted;
+}
+
+inline std::span<const compressed_graph::size_type>
+compressed_graph::out_edges(size_type node) const {
+    return { m_outTargets.data() + m_outOffsets[node],
+             m_outTargets.data() + m_outOffsets[node + 1] };
+}
+
+inline std::span<const compressed_graph::size_type>
+compressed_graph::in_edges(size_type node) const {
+    return { m_inSources.data() + m_inOffsets[node],
+             m_inSources.data() + m_inOffsets[node + 1] };
+}
+
+inline std::span<const double>
+compressed_graph::out_weights(size_type node) const {
+    if (!m_weighted) { return {}; }
+    return { m_outWeights.data() + m_outOffsets[node],
+             m_outWeights.data() + m_outOffsets[node + 1] };
+}
+
+inline std::span<const double>
+compressed_graph::in_weights(size_type node) const {
+    if (!m_weighted) { return {}; }
+    return { m_inWeights.data() + m_inOffsets[node],
+             m_inWeights.data() + m_inOffsets[node + 1] };
+}
+
+inline compressed_graph::size_type
+compressed_graph::out_degree(size_type node) const {
+    return m_outOffsets[node + 1] - m_outOffsets[node];
+}
+
+inline compressed_graph::size_type
+compressed_graph::in_degree(size_type node) const {
+    return m_inOffsets[node + 1] - m_inOffsets[node];
+}
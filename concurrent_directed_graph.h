@@ -0,0 +1,300 @@
+//
+// A thread-safe directed graph for write-heavy concurrent workloads.
+//
+#pragma once
+
+#include "directed_graph.h"
+#include "graph_common.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// A directed graph that can be used from many threads at once without
+// external locking. Nodes are partitioned into shards by the hash of their
+// value. Each shard holds its nodes' values, adjacency lists and its part of
+// the value index, guarded by its own reader-writer lock, so operations on
+// nodes in different shards never contend.
+//
+// Nodes cannot be erased, which keeps node ids stable: the id of a node
+// never changes once it has been inserted. Ids are not contiguous, but are
+// all less than id_bound().
+template<typename T>
+class concurrent_directed_graph {
+    static_assert(details::hashable<T>,
+                  "concurrent_directed_graph requires std::hash<T>");
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+
+    // Returned by index_of when the value is not in the graph
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    explicit concurrent_directed_graph(size_type shard_count = 64);
+
+    // Returns true if the node is inserted, or false if it was already
+    // present
+    bool insert(const T& node_value);
+
+    // Returns true if the edge was inserted successfully
+    bool insert_edge(const T& from_node_value, const T& to_node_value);
+
+    bool insert_edge(node_id from, node_id to);
+
+    // Returns true if the edge is removed successfully
+    bool erase_edge(const T& from_node_value, const T& to_node_value);
+
+    bool erase_edge(node_id from, node_id to);
+
+    [[nodiscard]] bool contains(const T& node_value) const;
+
+    // Returns the stable id of the node with node_value, or npos if there is
+    // no such node
+    [[nodiscard]] size_type index_of(const T& node_value) const;
+
+    // Returns a set with the values of the nodes connected to the node with
+    // node_value
+    [[nodiscard]] std::set<T, std::less<>>
+    get_adjacent_nodes_values(const T& node_value) const;
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    // One more than the largest node id currently in use
+    [[nodiscard]] size_type id_bound() const;
+
+    // Copies the graph into a directed_graph, with nodes in id order. All
+    // shards are locked for reading while the copy is taken, so it is a
+    // consistent view of the graph.
+    [[nodiscard]] directed_graph<T> to_directed_graph() const;
+
+private:
+    struct shard {
+        mutable std::shared_mutex mutex;
+        // Deques, so that growing a shard never moves existing nodes
+        std::deque<T> values;
+        std::deque<std::set<size_type>> adjacency;
+        std::unordered_map<T, size_type> indices;
+    };
+
+    std::vector<std::unique_ptr<shard>> m_shards;
+    std::atomic<size_type> m_size{ 0 };
+
+    [[nodiscard]] size_type shard_of(const T& node_value) const;
+
+    // Node ids interleave the shards: id = local index * shards + shard
+    [[nodiscard]] size_type make_id(size_type shard_index,
+                                    size_type local_index) const;
+
+    [[nodiscard]] size_type shard_of_id(size_type id) const;
+
+    [[nodiscard]] size_type local_index_of_id(size_type id) const;
+};
+
+template<typename T>
+concurrent_directed_graph<T>::concurrent_directed_graph(size_type shard_count) {
+    m_shards.reserve(std::max<size_type>(shard_count, 1));
+    for (size_type i{ 0 }; i < std::max<size_type>(shard_count, 1); ++i) {
+        m_shards.push_back(std::make_unique<shard>());
+    }
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::shard_of(const T& node_value) const {
+    return details::mix_hash(std::hash<T>{}(node_value)) % m_shards.size();
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::make_id(size_type shard_index,
+                                      size_type local_index) const {
+    return local_index * m_shards.size() + shard_index;
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::shard_of_id(size_type id) const {
+    return id % m_shards.size();
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::local_index_of_id(size_type id) const {
+    return id / m_shards.size();
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::insert(const T& node_value) {
+    auto& s{ *m_shards[shard_of(node_value)] };
+    std::unique_lock lock{ s.mutex };
+    if (!s.indices.try_emplace(node_value, s.values.size()).second) {
+        return false;
+    }
+    s.values.push_back(node_value);
+    s.adjacency.emplace_back();
+    ++m_size;
+    return true;
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::insert_edge(const T& from_node_value,
+                                               const T& to_node_value) {
+    // Resolve both ends first, so that at most one lock is held at a time
+    const auto from{ index_of(from_node_value) };
+    const auto to{ index_of(to_node_value) };
+    if (from == npos || to == npos) { return false; }
+    return insert_edge(node_id{ from }, node_id{ to });
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::insert_edge(node_id from, node_id to) {
+    {
+        auto& to_shard{ *m_shards[shard_of_id(to.index)] };
+        std::shared_lock lock{ to_shard.mutex };
+        if (local_index_of_id(to.index) >= to_shard.values.size()) {
+            return false;
+        }
+    }
+    auto& from_shard{ *m_shards[shard_of_id(from.index)] };
+    std::unique_lock lock{ from_shard.mutex };
+    const auto local{ local_index_of_id(from.index) };
+    if (local >= from_shard.values.size()) { return false; }
+    return from_shard.adjacency[local].insert(to.index).second;
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::erase_edge(const T& from_node_value,
+                                              const T& to_node_value) {
+    const auto from{ index_of(from_node_value) };
+    const auto to{ index_of(to_node_value) };
+    if (from == npos || to == npos) { return false; }
+    return erase_edge(node_id{ from }, node_id{ to });
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::erase_edge(node_id from, node_id to) {
+    auto& from_shard{ *m_shards[shard_of_id(from.index)] };
+    std::unique_lock lock{ from_shard.mutex };
+    const auto local{ local_index_of_id(from.index) };
+    if (local >= from_shard.values.size()) { return false; }
+    // Only ids of existing nodes are ever inserted, so an invalid `to`
+    // simply finds no edge
+    return from_shard.adjacency[local].erase(to.index) != 0;
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::contains(const T& node_value) const {
+    return index_of(node_value) != npos;
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::index_of(const T& node_value) const {
+    const auto shard_index{ shard_of(node_value) };
+    const auto& s{ *m_shards[shard_index] };
+    std::shared_lock lock{ s.mutex };
+    const auto iter{ s.indices.find(node_value) };
+    if (iter == std::end(s.indices)) { return npos; }
+    return make_id(shard_index, iter->second);
+}
+
+template<typename T>
+std::set<T, std::less<>>
+concurrent_directed_graph<T>::get_adjacent_nodes_values(
+    const T& node_value) const {
+    std::set<T, std::less<>> values;
+    std::vector<size_type> targets;
+    {
+        const auto& s{ *m_shards[shard_of(node_value)] };
+        std::shared_lock lock{ s.mutex };
+        const auto iter{ s.indices.find(node_value) };
+        if (iter == std::end(s.indices)) { return values; }
+        const auto& adjacency{ s.adjacency[iter->second] };
+        targets.assign(std::begin(adjacency), std::end(adjacency));
+    }
+    // Visit the targets shard by shard, taking each shard's lock once
+    std::sort(std::begin(targets), std::end(targets),
+              [this](size_type a, size_type b) {
+                  return shard_of_id(a) < shard_of_id(b);
+              });
+    for (auto first{ std::begin(targets) }; first != std::end(targets);) {
+        const auto shard_index{ shard_of_id(*first) };
+        const auto last{ std::find_if(first, std::end(targets),
+                                      [this, shard_index](size_type id) {
+                                          return shard_of_id(id) != shard_index;
+                                      }) };
+        const auto& s{ *m_shards[shard_index] };
+        std::shared_lock lock{ s.mutex };
+        for (; first != last; ++first) {
+            values.insert(s.values[local_index_of_id(*first)]);
+        }
+    }
+    return values;
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::size() const noexcept {
+    return m_size.load();
+}
+
+template<typename T>
+bool concurrent_directed_graph<T>::empty() const noexcept {
+    return size() == 0;
+}
+
+template<typename T>
+typename concurrent_directed_graph<T>::size_type
+concurrent_directed_graph<T>::id_bound() const {
+    size_type bound{ 0 };
+    for (size_type i{ 0 }; i < m_shards.size(); ++i) {
+        std::shared_lock lock{ m_shards[i]->mutex };
+        const auto count{ m_shards[i]->values.size() };
+        if (count != 0) { bound = std::max(bound, make_id(i, count - 1) + 1); }
+    }
+    return bound;
+}
+
+template<typename T>
+directed_graph<T> concurrent_directed_graph<T>::to_directed_graph() const {
+    // Lock every shard, always in the same order
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(m_shards.size());
+    for (auto&& s: m_shards) { locks.emplace_back(s->mutex); }
+
+    size_type bound{ 0 };
+    for (size_type i{ 0 }; i < m_shards.size(); ++i) {
+        const auto count{ m_shards[i]->values.size() };
+        if (count != 0) { bound = std::max(bound, make_id(i, count - 1) + 1); }
+    }
+
+    // Map the sparse ids onto the dense positions of the new graph
+    directed_graph<T> graph;
+    std::vector<size_type> positions(bound, npos);
+    for (size_type id{ 0 }; id < bound; ++id) {
+        const auto& s{ *m_shards[shard_of_id(id)] };
+        const auto local{ local_index_of_id(id) };
+        if (local < s.values.size()) {
+            positions[id] = graph.size();
+            graph.insert(s.values[local]);
+        }
+    }
+    for (size_type id{ 0 }; id < bound; ++id) {
+        if (positions[id] == npos) { continue; }
+        const auto& s{ *m_shards[shard_of_id(id)] };
+        for (auto&& target: s.adjacency[local_index_of_id(id)]) {
+            graph.insert_edge(node_id{ positions[id] },
+                              node_id{ positions[target] });
+        }
+    }
+    return graph;
+}
@@ -0,0 +1,596 @@
+//
+// Contraction hierarchies, for fast point-to-point shortest path queries.
+//
+#pragma once
+
+#include "graph_common.h"
+#include "graph_traversal.h"
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace details {
+    // The graph that remains while a contraction hierarchy is built, with
+    // both the out-edges and the in-edges of each node, and at most one edge
+    // between each pair of nodes
+    class contraction_graph {
+    public:
+        static constexpr std::size_t npos{ static_cast<std::size_t>(-1) };
+
+        // An edge, seen from one of its ends: the other end, the weight,
+        // and the node a shortcut bypasses, or npos for an original edge
+        struct edge {
+            std::size_t node;
+            double weight;
+            std::size_t middle;
+        };
+
+        explicit contraction_graph(std::size_t size);
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        [[nodiscard]] const std::vector<edge>&
+        out_edges(std::size_t node) const;
+
+        [[nodiscard]] const std::vector<edge>&
+        in_edges(std::size_t node) const;
+
+        // Adds an edge, or lowers the weight of the existing one if this is
+        // shorter
+        void add_edge(std::size_t from, std::size_t to, double weight,
+                      std::size_t middle);
+
+        // Removes node's edges from its neighbours, and marks it removed
+        void remove(std::size_t node);
+
+        // Marks node as about to be removed, so that witness searches don't
+        // go through it
+        void exclude(std::size_t node);
+
+        // Calls emit(from, to, weight) for each shortcut that removing node
+        // would need: for each path from -> node -> to with no shorter path
+        // from `from` to `to` that avoids node and excluded nodes. Witness
+        // searches give up after settling settle_limit nodes, which may add
+        // a shortcut that wasn't needed but never misses one. witness is
+        // scratch space, so that concurrent calls each need their own.
+        template<typename F>
+        void find_shortcuts(std::size_t node, std::size_t settle_limit,
+                            dijkstra_state& witness, F&& emit) const;
+
+    private:
+        std::vector<std::vector<edge>> m_outEdges;
+        std::vector<std::vector<edge>> m_inEdges;
+        node_bitset m_excluded;
+    };
+
+    inline contraction_graph::contraction_graph(std::size_t size)
+        : m_outEdges(size), m_inEdges(size), m_excluded{ size } {}
+
+    inline std::size_t contraction_graph::size() const noexcept {
+        return m_outEdges.size();
+    }
+
+    inline const std::vector<contraction_graph::edge>&
+    contraction_graph::out_edges(std::size_t node) const {
+        return m_outEdges[node];
+    }
+
+    inline const std::vector<contraction_graph::edge>&
+    contraction_graph::in_edges(std::size_t node) const {
+        return m_inEdges[node];
+    }
+
+    inline void contraction_graph::add_edge(std::size_t from, std::size_t to,
+                                            double weight,
+                                            std::size_t middle) {
+        auto& out{ m_outEdges[from] };
+        const auto iter{ std::find_if(
+            std::begin(out), std::end(out),
+            [to](const edge& e) { return e.node == to; }) };
+        if (iter == std::end(out)) {
+            out.push_back({ to, weight, middle });
+            m_inEdges[to].push_back({ from, weight, middle });
+            return;
+        }
+        if (!(weight < iter->weight)) { return; }
+        *iter = { to, weight, middle };
+        auto& in{ m_inEdges[to] };
+        *std::find_if(std::begin(in), std::end(in), [from](const edge& e) {
+            return e.node == from;
+        }) = { from, weight, middle };
+    }
+
+    inline void contraction_graph::remove(std::size_t node) {
+        const auto erase_from{ [node](std::vector<edge>& edges) {
+            edges.erase(std::find_if(
+                std::begin(edges), std::end(edges),
+                [node](const edge& e) { return e.node == node; }));
+        } };
+        for (auto&& e: m_outEdges[node]) { erase_from(m_inEdges[e.node]); }
+        for (auto&& e: m_inEdges[node]) { erase_from(m_outEdges[e.node]); }
+        m_outEdges[node] = {};
+        m_inEdges[node] = {};
+        m_excluded.set(node);
+    }
+
+    inline void contraction_graph::exclude(std::size_t node) {
+        m_excluded.set(node);
+    }
+
+    template<typename F>
+    void contraction_graph::find_shortcuts(std::size_t node,
+                                           std::size_t settle_limit,
+                                           dijkstra_state& witness,
+                                           F&& emit) const {
+        const auto& outs{ m_outEdges[node] };
+        const auto& ins{ m_inEdges[node] };
+        if (outs.empty() || ins.empty()) { return; }
+        double max_out{ 0 };
+        for (auto&& out: outs) { max_out = std::max(max_out, out.weight); }
+
+        for (auto&& in: ins) {
+            // Only paths no longer than the longest one through node matter
+            const auto limit{ in.weight + max_out };
+            witness.reset(size());
+            witness.relax(in.node, 0, in.node);
+            // Stop once every target has been settled, as well
+            auto targets_left{ outs.size() };
+            std::size_t settled{ 0 };
+            while (!witness.heap.empty() && witness.heap.top_key() <= limit &&
+                   settled < settle_limit && targets_left > 0) {
+                const auto from{ witness.heap.top() };
+                const auto distance{ witness.heap.top_key() };
+                witness.heap.pop();
+                ++settled;
+                if (std::any_of(std::begin(outs), std::end(outs),
+                                [from](const edge& e) {
+                                    return e.node == from;
+                                })) {
+                    --targets_left;
+                }
+                for (auto&& e: m_outEdges[from]) {
+                    if (e.node == node || m_excluded.test(e.node)) {
+                        continue;
+                    }
+                    witness.relax(e.node, distance + e.weight, from);
+                }
+            }
+            for (auto&& out: outs) {
+                if (out.node == in.node) { continue; }
+                const auto via{ in.weight + out.weight };
+                if (witness.distances[out.node] > via) {
+                    emit(in.node, out.node, via);
+                }
+            }
+        }
+    }
+}// namespace details
+
+// A contraction hierarchy (Geisberger, Sanders, Schultes and Delling) over a
+// static weighted graph, for answering many point-to-point shortest path
+// queries with contraction_hierarchy_search.
+//
+// Building it removes ("contracts") the nodes one at a time, from the least
+// to the most important, and adds a shortcut edge wherever a removal would
+// break a shortest path. Queries then search upwards in that order from
+// both ends, and settle a few hundred nodes where Dijkstra would settle a
+// large part of the graph. Importance is the number of shortcuts a node's
+// removal would add less the edges it would remove, plus the number of its
+// neighbours already removed. Each round removes every node that is less
+// important than all of its neighbours, and the searches that decide a
+// round's shortcuts run in parallel.
+class contraction_hierarchy {
+public:
+    using size_type = std::size_t;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    contraction_hierarchy() = default;
+
+    // Builds the hierarchy for a weighted_directed_graph, a directed_graph,
+    // with unit weights, or a compressed_graph. The graph must not be
+    // modified while this runs, and its edge weights must not be negative.
+    // Node indices in queries are the graph's.
+    template<typename Graph>
+    explicit contraction_hierarchy(const Graph& graph,
+                                   thread_pool& pool = default_thread_pool());
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    // Position of node in the order nodes were contracted in
+    [[nodiscard]] size_type rank(size_type node) const;
+
+    // Number of shortcut edges the hierarchy added
+    [[nodiscard]] size_type shortcut_count() const noexcept;
+
+private:
+    friend class contraction_hierarchy_search;
+
+    // Edges of the hierarchy in compressed sparse row form, grouped by
+    // their lower-ranked end and sorted by their other end. A shortcut's
+    // middle is the node it bypasses; original edges have none.
+    struct edge_rows {
+        std::vector<size_type> offsets{ 0 };
+        std::vector<size_type> ends;
+        std::vector<double> weights;
+        std::vector<size_type> middles;
+    };
+
+    std::vector<size_type> m_ranks;
+    // Edges to higher-ranked nodes, for the forward search
+    edge_rows m_upward;
+    // Edges from higher-ranked nodes, for the backward search
+    edge_rows m_downward;
+
+    // The node the hierarchy edge from -> to bypasses, or npos
+    [[nodiscard]] size_type middle(size_type from, size_type to) const;
+
+    // Appends the nodes after from on the original path that the hierarchy
+    // edge from -> to stands for
+    void unpack(size_type from, size_type to,
+                std::vector<size_type>& nodes) const;
+};
+
+// Point-to-point queries on a contraction_hierarchy. Both searches only
+// follow edges to higher-ranked nodes, and skip ("stall") nodes that they
+// can see are reached more cheaply from above. A path's shortcuts are
+// expanded back into original edges. As with dijkstra_search, the search
+// arrays are kept between queries, and an object must only be used by one
+// thread at a time; a hierarchy can be queried by many threads at once.
+class contraction_hierarchy_search {
+public:
+    using size_type = std::size_t;
+
+    // Returns the length of a shortest path from source to target, or
+    // infinity if there is none
+    double distance(const contraction_hierarchy& hierarchy, node_id source,
+                    node_id target);
+
+    // Returns a shortest path from source to target
+    weighted_path path(const contraction_hierarchy& hierarchy, node_id source,
+                       node_id target);
+
+    // Number of nodes the last query settled, in both directions
+    [[nodiscard]] size_type settled_count() const noexcept;
+
+private:
+    details::dijkstra_state m_forward;
+    details::dijkstra_state m_backward;
+    size_type m_settled{ 0 };
+    // The highest node on the path the last query found, or npos
+    size_type m_meeting{ details::dijkstra_state::npos };
+
+    double search(const contraction_hierarchy& hierarchy, node_id source,
+                  node_id target);
+
+    // Settles the nearest node of one search, as in
+    // bidirectional_dijkstra_search::expand
+    template<bool Backward>
+    void expand(const contraction_hierarchy& hierarchy,
+                details::dijkstra_state& state,
+                const details::dijkstra_state& other, double& best);
+};
+
+template<typename Graph>
+contraction_hierarchy::contraction_hierarchy(const Graph& graph,
+                                             thread_pool& pool) {
+    using edge = details::contraction_graph::edge;
+    const auto n{ graph.size() };
+    details::contraction_graph remaining{ n };
+    for (size_type from{ 0 }; from < n; ++from) {
+        details::for_each_weighted_edge(
+            graph, from, [&](size_type to, double weight) {
+                if (to != from) { remaining.add_edge(from, to, weight, npos); }
+            });
+    }
+
+    // Witness searches are cut short when estimating a node's importance,
+    // which is redone many times, but run further when contracting it
+    constexpr size_type estimate_settle_limit{ 10 };
+    constexpr size_type contract_settle_limit{ 500 };
+    std::vector<details::dijkstra_state> witnesses(pool.size());
+    std::vector<std::int64_t> priorities(n);
+    std::vector<std::int64_t> removed_neighbours(n, 0);
+    auto update_priority{ [&](size_type worker, size_type node) {
+        std::int64_t shortcuts{ 0 };
+        remaining.find_shortcuts(node, estimate_settle_limit,
+                                 witnesses[worker],
+                                 [&](size_type, size_type, double) {
+                                     ++shortcuts;
+                                 });
+        const auto degree{ remaining.out_edges(node).size() +
+                           remaining.in_edges(node).size() };
+        priorities[node] = shortcuts - static_cast<std::int64_t>(degree) +
+                           removed_neighbours[node];
+    } };
+    pool.parallel_for_chunks(
+        0, n,
+        [&](size_type worker, size_type first, size_type last) {
+            for (auto node{ first }; node < last; ++node) {
+                update_priority(worker, node);
+            }
+        },
+        64);
+    // Ties are broken by a hash, so that regular graphs such as grids
+    // don't get contracted in long runs of neighbouring nodes
+    auto precedes{ [&](size_type a, size_type b) {
+        return std::tuple{ priorities[a], details::mix_hash(a), a } <
+               std::tuple{ priorities[b], details::mix_hash(b), b };
+    } };
+
+    struct shortcut {
+        size_type from;
+        size_type to;
+        double weight;
+        size_type middle;
+    };
+    std::vector<std::vector<size_type>> worker_selected(pool.size());
+    std::vector<std::vector<shortcut>> shortcuts(pool.size());
+    std::vector<std::vector<edge>> upward(n);
+    std::vector<std::vector<edge>> downward(n);
+    std::vector<size_type> order(n);
+    std::iota(std::begin(order), std::end(order), size_type{ 0 });
+    std::vector<size_type> selected;
+    std::vector<size_type> neighbours;
+    m_ranks.assign(n, npos);
+    size_type next_rank{ 0 };
+
+    while (!order.empty()) {
+        // Pick the nodes that are less important than all their neighbours.
+        // No two of them are adjacent.
+        for (auto& nodes: worker_selected) { nodes.clear(); }
+        pool.parallel_for_chunks(
+            0, order.size(),
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto i{ first }; i < last; ++i) {
+                    const auto node{ order[i] };
+                    const auto beaten{ [&](const edge& e) {
+                        return precedes(e.node, node);
+                    } };
+                    if (std::none_of(std::begin(remaining.out_edges(node)),
+                                     std::end(remaining.out_edges(node)),
+                                     beaten) &&
+                        std::none_of(std::begin(remaining.in_edges(node)),
+                                     std::end(remaining.in_edges(node)),
+                                     beaten)) {
+                        worker_selected[worker].push_back(node);
+                    }
+                }
+            },
+            256);
+        selected.clear();
+        for (auto& nodes: worker_selected) {
+            selected.insert(std::end(selected), std::begin(nodes),
+                            std::end(nodes));
+        }
+
+        // Find their shortcuts in parallel. Witnesses mustn't go through a
+        // node contracted in the same round, or two nodes could each rely
+        // on a path through the other.
+        for (auto node: selected) { remaining.exclude(node); }
+        for (auto& found: shortcuts) { found.clear(); }
+        pool.parallel_for_chunks(
+            0, selected.size(),
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto i{ first }; i < last; ++i) {
+                    const auto node{ selected[i] };
+                    remaining.find_shortcuts(
+                        node, contract_settle_limit, witnesses[worker],
+                        [&](size_type from, size_type to, double weight) {
+                            shortcuts[worker].push_back(
+                                { from, to, weight, node });
+                        });
+                }
+            },
+            16);
+
+        // Contract them. Their remaining neighbours all come later in the
+        // order, so their remaining edges are the hierarchy's.
+        neighbours.clear();
+        for (auto node: selected) {
+            m_ranks[node] = next_rank++;
+            upward[node] = remaining.out_edges(node);
+            downward[node] = remaining.in_edges(node);
+            for (auto&& e: upward[node]) { neighbours.push_back(e.node); }
+            for (auto&& e: downward[node]) { neighbours.push_back(e.node); }
+            remaining.remove(node);
+        }
+        for (auto& found: shortcuts) {
+            for (auto&& s: found) {
+                remaining.add_edge(s.from, s.to, s.weight, s.middle);
+            }
+        }
+        for (auto neighbour: neighbours) { ++removed_neighbours[neighbour]; }
+        std::sort(std::begin(neighbours), std::end(neighbours));
+        neighbours.erase(
+            std::unique(std::begin(neighbours), std::end(neighbours)),
+            std::end(neighbours));
+        pool.parallel_for_chunks(
+            0, neighbours.size(),
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto i{ first }; i < last; ++i) {
+                    update_priority(worker, neighbours[i]);
+                }
+            },
+            16);
+        std::erase_if(order, [this](size_type node) {
+            return m_ranks[node] != npos;
+        });
+    }
+
+    const auto flatten{ [n](std::vector<std::vector<edge>>& lists,
+                            edge_rows& rows) {
+        rows.offsets.assign(n + 1, 0);
+        for (size_type node{ 0 }; node < n; ++node) {
+            auto& list{ lists[node] };
+            std::sort(std::begin(list), std::end(list),
+                      [](const edge& a, const edge& b) {
+                          return a.node < b.node;
+                      });
+            rows.offsets[node + 1] = rows.offsets[node] + list.size();
+            for (auto&& e: list) {
+                rows.ends.push_back(e.node);
+                rows.weights.push_back(e.weight);
+                rows.middles.push_back(e.middle);
+            }
+            list = {};
+        }
+    } };
+    flatten(upward, m_upward);
+    flatten(downward, m_downward);
+}
+
+inline contraction_hierarchy::size_type
+contraction_hierarchy::size() const noexcept {
+    return m_ranks.size();
+}
+
+inline contraction_hierarchy::size_type
+contraction_hierarchy::rank(size_type node) const {
+    return m_ranks[node];
+}
+
+inline contraction_hierarchy::size_type
+contraction_hierarchy::shortcut_count() const noexcept {
+    const auto is_shortcut{ [](size_type middle) { return middle != npos; } };
+    return std::count_if(std::begin(m_upward.middles),
+                         std::end(m_upward.middles), is_shortcut) +
+           std::count_if(std::begin(m_downward.middles),
+                         std::end(m_downward.middles), is_shortcut);
+}
+
+inline contraction_hierarchy::size_type
+contraction_hierarchy::middle(size_type from, size_type to) const {
+    // Each edge is stored once, at its lower-ranked end
+    const auto& rows{ m_ranks[from] < m_ranks[to] ? m_upward : m_downward };
+    const auto node{ m_ranks[from] < m_ranks[to] ? from : to };
+    const auto other{ m_ranks[from] < m_ranks[to] ? to : from };
+    const auto first{ std::begin(rows.ends) + rows.offsets[node] };
+    const auto last{ std::begin(rows.ends) + rows.offsets[node + 1] };
+    return rows.middles[std::lower_bound(first, last, other) -
+                        std::begin(rows.ends)];
+}
+
+inline void contraction_hierarchy::unpack(size_type from, size_type to,
+                                          std::vector<size_type>& nodes) const {
+    // Expand shortcuts depth first, left half before right half
+    std::vector<std::pair<size_type, size_type>> pending{ { from, to } };
+    while (!pending.empty()) {
+        const auto [a, b]{ pending.back() };
+        pending.pop_back();
+        const auto bypassed{ middle(a, b) };
+        if (bypassed == npos) {
+            nodes.push_back(b);
+        } else {
+            pending.emplace_back(bypassed, b);
+            pending.emplace_back(a, bypassed);
+        }
+    }
+}
+
+inline double
+contraction_hierarchy_search::distance(const contraction_hierarchy& hierarchy,
+                                       node_id source, node_id target) {
+    return search(hierarchy, source, target);
+}
+
+inline weighted_path
+contraction_hierarchy_search::path(const contraction_hierarchy& hierarchy,
+                                   node_id source, node_id target) {
+    const auto cost{ search(hierarchy, source, target) };
+    weighted_path path{ {}, cost };
+    if (m_meeting == details::dijkstra_state::npos) { return path; }
+
+    // The hierarchy nodes on the path, up from the source and back down to
+    // the target, and then the original nodes between each pair
+    std::vector<size_type> hierarchy_nodes;
+    m_forward.append_path(m_meeting, hierarchy_nodes);
+    std::reverse(std::begin(hierarchy_nodes), std::end(hierarchy_nodes));
+    for (auto node{ m_meeting }; node != target.index;) {
+        node = m_backward.parents[node];
+        hierarchy_nodes.push_back(node);
+    }
+    path.nodes.push_back(source.index);
+    for (size_type i{ 1 }; i < hierarchy_nodes.size(); ++i) {
+        hierarchy.unpack(hierarchy_nodes[i - 1], hierarchy_nodes[i],
+                         path.nodes);
+    }
+    return path;
+}
+
+inline contraction_hierarchy_search::size_type
+contraction_hierarchy_search::settled_count() const noexcept {
+    return m_settled;
+}
+
+inline double
+contraction_hierarchy_search::search(const contraction_hierarchy& hierarchy,
+                                     node_id source, node_id target) {
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    const auto n{ hierarchy.size() };
+    m_forward.reset(n);
+    m_backward.reset(n);
+    m_settled = 0;
+    m_meeting = details::dijkstra_state::npos;
+    if (source.index >= n || target.index >= n) { return infinity; }
+
+    m_forward.relax(source.index, 0, source.index);
+    m_backward.relax(target.index, 0, target.index);
+    auto best{ infinity };
+    while (true) {
+        const auto forward_key{ m_forward.heap.empty()
+                                    ? infinity
+                                    : m_forward.heap.top_key() };
+        const auto backward_key{ m_backward.heap.empty()
+                                     ? infinity
+                                     : m_backward.heap.top_key() };
+        // Neither search can find anything shorter once both frontiers are
+        // at least as far as the best path
+        if (std::min(forward_key, backward_key) >= best) { break; }
+        if (forward_key <= backward_key) {
+            expand<false>(hierarchy, m_forward, m_backward, best);
+        } else {
+            expand<true>(hierarchy, m_backward, m_forward, best);
+        }
+    }
+    return best;
+}
+
+template<bool Backward>
+void contraction_hierarchy_search::expand(
+    const contraction_hierarchy& hierarchy, details::dijkstra_state& state,
+    const details::dijkstra_state& other, double& best) {
+    const auto node{ state.heap.top() };
+    const auto distance{ state.heap.top_key() };
+    state.heap.pop();
+    ++m_settled;
+    if (other.reached(node) && distance + other.distances[node] < best) {
+        best = distance + other.distances[node];
+        m_meeting = node;
+    }
+
+    const auto& upward{ Backward ? hierarchy.m_downward
+                                 : hierarchy.m_upward };
+    const auto& downward{ Backward ? hierarchy.m_upward
+                                   : hierarchy.m_downward };
+    // Stall the node if a higher one that this search has reached has a
+    // shorter way down to it: no shortest path then goes up through it
+    for (auto i{ downward.offsets[node] }; i < downward.offsets[node + 1];
+         ++i) {
+        if (state.distances[downward.ends[i]] + downward.weights[i] <
+            distance) {
+            return;
+        }
+    }
+    for (auto i{ upward.offsets[node] }; i < upward.offsets[node + 1]; ++i) {
+        state.relax(upward.ends[i], distance + upward.weights[i], node);
+    }
+}
@@ -3,11 +3,19 @@
 //
 
 #pragma once
+#include "graph_batch.h"
+#include "graph_common.h"
+#include "thread_pool.h"
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
 #include <format>
 #include <iterator>
+#include <optional>
 #include <set>
 #include <sstream>
+#include <tuple>
 #include <vector>
 
 template<typename T, typename A>
@@ -25,6 +33,9 @@ class const_adjacent_nodes_iterator;
 template<typename GraphType>
 class adjacent_nodes_iterator;
 
+template<typename T, typename A>
+class directed_graph_builder;
+
 namespace details {
     // Putting the allocation logic in a separate base class makes the
     // graph node constructor exception safe. The naive version could
@@ -102,6 +113,7 @@ namespace details {
 
     private:
         friend class directed_graph<T, A>;
+        friend class directed_graph_builder<T, A>;
 
         // A reference to the graph this node belongs to
         directed_graph<T, A>& m_graph;
@@ -116,19 +128,27 @@ namespace details {
         get_adjacent_nodes_indices() const;
 
         adjacency_list_type m_adjacentNodeIndices;
+
+        // Hash of the node's value, cached for fingerprint updates
+        std::uint64_t m_hash{ 0 };
+
+        // Number of edges into this node, kept up to date by the graph
+        std::size_t m_inDegree{ 0 };
     };
 
     template<typename T, typename A>
     graph_node<T, A>::graph_node(directed_graph<T, A>& graph, const T& t,
                                  const A& allocator)
-        : m_graph{ graph }, graph_node_allocator<T, A>{ allocator } {
+        : m_graph{ graph }, graph_node_allocator<T, A>{ allocator },
+          m_hash{ details::hash_value(t) } {
         new (this->m_data) T{ t };// Placement new
     }
 
     template<typename T, typename A>
     graph_node<T, A>::graph_node(directed_graph<T, A>& graph, T&& t,
                                  const A& allocator)
-        : m_graph{ graph }, graph_node_allocator<T, A>{ allocator } {
+        : m_graph{ graph }, graph_node_allocator<T, A>{ allocator },
+          m_hash{ details::hash_value(t) } {
         new (this->m_data) T{ std::move(t) };
     }
 
@@ -149,30 +169,37 @@ namespace details {
     template<typename T, typename A>
     graph_node<T, A>::graph_node(const graph_node& src)
         : graph_node_allocator<T, A>{ src.m_allocator }, m_graph{ src.m_graph },
-          m_adjacentNodeIndices{ src.m_adjacentNodeIndices } {
+          m_adjacentNodeIndices{ src.m_adjacentNodeIndices },
+          m_hash{ src.m_hash }, m_inDegree{ src.m_inDegree } {
         new (this->m_data) T{ *(src.m_data) };
     }
 
     template<typename T, typename A>
     graph_node<T, A>::graph_node(graph_node&& src) noexcept
         : graph_node_allocator<T, A>{ std::move(src) }, m_graph{ src.m_graph },
-          m_adjacentNodeIndices{ std::move(src.m_adjacentNodeIndices) } {}
+          m_adjacentNodeIndices{ std::move(src.m_adjacentNodeIndices) },
+          m_hash{ src.m_hash }, m_inDegree{ src.m_inDegree } {}
 
     template<typename T, typename A>
     graph_node<T, A>& graph_node<T, A>::operator=(const graph_node& rhs) {
+        // m_graph is a reference, and a node stays with the graph it was
+        // made for, so it isn't assigned
         if (this != &rhs) {
-            m_graph = rhs.m_graph;
             m_adjacentNodeIndices = rhs.m_adjacentNodeIndices;
-            new (this->m_data) T{ *(rhs.m_data) };
+            m_hash = rhs.m_hash;
+            m_inDegree = rhs.m_inDegree;
+            *(this->m_data) = *(rhs.m_data);
         }
         return *this;
     }
 
     template<typename T, typename A>
     graph_node<T, A>& graph_node<T, A>::operator=(graph_node&& rhs) noexcept {
-        m_graph = rhs.m_graph;
         m_adjacentNodeIndices = std::move(rhs.m_adjacentNodeIndices);
-        this->m_data = std::exchange(rhs.m_data, nullptr);
+        m_hash = rhs.m_hash;
+        m_inDegree = rhs.m_inDegree;
+        // Swap rather than overwrite, so that rhs cleans up the old value
+        std::swap(this->m_data, rhs.m_data);
         return *this;
     }
 
@@ -221,6 +248,9 @@ public:
     using size_type = size_t;
     using difference_type = ptrdiff_t;
 
+    // Returned by index_of when the value is not in the graph
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
     // Constructors
     // Let the compiler default the default constructor, but make it noexcept
     // iff the allocator's default constructor is also noexcept
@@ -234,6 +264,8 @@ public:
     using const_iterator = const_directed_graph_iterator<directed_graph>;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    // The non-const adjacent node iterator hands out node_value_reference,
+    // so that writing to a node's value goes through set_value()
     using iterator_adjacent_nodes = adjacent_nodes_iterator<directed_graph>;
     using const_iterator_adjacent_nodes =
         const_adjacent_nodes_iterator<directed_graph>;
@@ -241,6 +273,7 @@ public:
         std::reverse_iterator<iterator_adjacent_nodes>;
     using const_reverse_iterator_adjacent_nodes =
         std::reverse_iterator<const_iterator_adjacent_nodes>;
+    using const_iterator_adjacent_indices = std::set<size_t>::const_iterator;
 
     // Iterator methods
     iterator begin() noexcept;
@@ -318,31 +351,90 @@ public:
     // Returns true if the edge was inserted successfully
     bool insert_edge(const T& from_node_value, const T& to_node_value);
 
+    bool insert_edge(node_id from, node_id to);
+
     // Returns true if the edge is removed successfully
     bool erase_edge(const T& from_node_value, const T& to_node_value);
 
+    bool erase_edge(node_id from, node_id to);
+
+    // Returns true if there is an edge from from_node_value to
+    // to_node_value. The nodes are found through the hashed value index,
+    // in O(1) on average when T is hashable, and the edge in the source's
+    // own adjacency list, in O(log d) for a node with d out-edges. A hashed
+    // set of targets per node would make this O(1), but would store every
+    // edge twice and slow down every edge insertion and erasure.
+    [[nodiscard]] bool has_edge(const T& from_node_value,
+                                const T& to_node_value) const;
+
+    [[nodiscard]] bool has_edge(node_id from, node_id to) const;
+
+    // Numbers of edges out of and into the node with node_value, or 0 if
+    // there is no such node. Both are stored, so these are O(1) on average
+    // when T is hashable, and the index-based overloads are always O(1).
+    [[nodiscard]] size_type out_degree(const T& node_value) const;
+
+    [[nodiscard]] size_type in_degree(const T& node_value) const;
+
+    [[nodiscard]] size_type out_degree(node_id node) const;
+
+    [[nodiscard]] size_type in_degree(node_id node) const;
+
+    // Applies all the changes recorded in batch. Node insertions are applied
+    // first, then edge changes, then node erasures, so edges can be added
+    // to new nodes and an erased node takes all its edges with it. If the
+    // batch changes the same edge more than once, the last change wins.
+    // Edge changes naming a node that isn't in the graph are skipped.
+    //
+    // Values are found through the hashed value index, and edge changes are
+    // grouped by source node so that each adjacency list is updated in a
+    // single pass, with different nodes updated in parallel.
+    void apply(const graph_batch<T>& batch,
+               thread_pool& pool = default_thread_pool());
+
     // Empties the graph
     void clear() noexcept;
 
-    // Returns a reference to the object at index. No bounds checking.
-    reference operator[](size_t index);
+    // Returns a reference to the object at index. No bounds checking. Nodes
+    // are indexed by the hashes of their values, so the non-const overload
+    // returns a node_value_reference, which assigns through set_value().
+    node_value_reference<directed_graph> operator[](size_type index);
 
-    const_reference operator[](size_t index) const;
+    const_reference operator[](size_type index) const;
 
     // Bounds-checking equivalents to operator[]
-    reference at(size_type index);
+    node_value_reference<directed_graph> at(size_type index);
 
     const_reference at(size_type index) const;
 
+    // Replaces the value of the node at index, keeping its edges, and
+    // updates the value index and fingerprint to match. Returns false and
+    // leaves the graph unchanged if index is out of range or another node
+    // already has node_value. The edges into the node are found by scanning
+    // the other adjacency lists, so this is O(V) unless it has none.
+    bool set_value(size_type index, T node_value);
+
     // Graphs are equal if they contain the same nodes and edges,
     // regardless of order
     bool operator==(const directed_graph& rhs) const;
 
+    // Returns the first difference found between this graph and rhs, or
+    // nothing if they are equal. Runs in O(V + E) when T is hashable.
+    [[nodiscard]] std::optional<graph_difference>
+    first_difference(const directed_graph& rhs) const;
+
     bool operator!=(const directed_graph& rhs) const;
 
     // Swaps all nodes between this graph and other_graph
     void swap(directed_graph& other_graph) noexcept;
 
+    // Order-independent hash of the graph's node values and edges, kept up
+    // to date by every modification. Equal graphs have equal fingerprints,
+    // so differing fingerprints mean the graphs differ. If T has no
+    // std::hash specialisation, only the numbers of nodes and edges are
+    // reflected.
+    [[nodiscard]] std::uint64_t fingerprint() const noexcept;
+
     [[nodiscard]] size_type size() const noexcept;
 
     [[nodiscard]] size_type max_size() const noexcept;
@@ -354,8 +446,35 @@ public:
     [[nodiscard]] std::set<T, std::less<>, A>
     get_adjacent_nodes_values(const T& node_value) const;
 
+    // Views over the nodes connected to the node with node_value, read
+    // straight from the adjacency list without copying. The first yields
+    // node values, the second their indices. Both are empty if node_value
+    // is not in the graph.
+    [[nodiscard]] iterator_range<const_iterator_adjacent_nodes>
+    adjacent_nodes(const T& node_value) const;
+
+    [[nodiscard]] iterator_range<const_iterator_adjacent_indices>
+    adjacent_node_indices(const T& node_value) const;
+
+    // Index-based access, for algorithms that work on dense node ids
+    // rather than values. Node indices are positions in the graph, as used
+    // by operator[], and are shifted down by erasing an earlier node.
+
+    // View over the indices of the nodes connected to the node at index, in
+    // ascending order. No bounds checking.
+    [[nodiscard]] iterator_range<const_iterator_adjacent_indices>
+    out_edges(size_type index) const;
+
+    // Returns the value of the node at index. No bounds checking.
+    [[nodiscard]] const_reference value(size_type index) const;
+
+    // Returns the index of the node with node_value, or npos if there is no
+    // such node
+    [[nodiscard]] size_type index_of(const T& node_value) const;
+
 private:
     friend class details::graph_node<T, A>;
+    friend class directed_graph_builder<T, A>;
     friend class const_directed_graph_iterator<directed_graph>;
     friend class directed_graph_iterator<directed_graph>;
 
@@ -363,6 +482,20 @@ private:
 
     nodes_container_type m_nodes;
     A m_allocator;
+    std::uint64_t m_fingerprint{ 0 };
+
+    // Hashed lookup by node value, kept in step with m_nodes
+    details::value_index_type<T> m_valueIndex;
+
+    // Adds the last node in m_nodes to the value index
+    void index_last_node();
+
+    // Rebuilds the value index from scratch, after nodes have been erased
+    // and the remaining ones renumbered
+    void rebuild_value_index();
+
+    // Rebuilds the value index and the in-degree counts from scratch
+    void rebuild_indices();
 
     // Returns an iterator at the searched-for value, or the end iterator
     // if the value is not found.
@@ -378,6 +511,15 @@ private:
     void remove_all_links_to(
         typename nodes_container_type::const_iterator node_iter);
 
+    // Applies edge changes sorted by source, target and sequence number
+    void apply_edge_changes(
+        const std::vector<typename graph_batch<T>::edge_change>& changes,
+        thread_pool& pool);
+
+    // Erases every node whose index maps to npos, and renumbers the others
+    // to the indices given by remap
+    void erase_nodes(const std::vector<size_type>& remap, thread_pool& pool);
+
     [[nodiscard]] std::set<T, std::less<>, A> get_adjacent_nodes_values(
         const typename details::graph_node<T, A>::adjacency_list_type& indices)
         const;
@@ -397,9 +539,21 @@ directed_graph<T, A>::directed_graph(const A& allocator) noexcept
 template<typename T, typename A>
 typename directed_graph<T, A>::nodes_container_type::iterator
 directed_graph<T, A>::findNode(const T& node_value) {
-    return std::find_if(
-        std::begin(m_nodes), std::end(m_nodes),
-        [&node_value](const auto& node) { return node.value() == node_value; });
+    if constexpr (details::hashable<T>) {
+        const auto [first, last]{ m_valueIndex.equal_range(
+            details::hash_value(node_value)) };
+        for (auto iter{ first }; iter != last; ++iter) {
+            if (m_nodes[iter->second].value() == node_value) {
+                return std::begin(m_nodes) + iter->second;
+            }
+        }
+        return std::end(m_nodes);
+    } else {
+        return std::find_if(std::begin(m_nodes), std::end(m_nodes),
+                            [&node_value](const auto& node) {
+                                return node.value() == node_value;
+                            });
+    }
 }
 
 template<typename T, typename A>
@@ -417,9 +571,39 @@ directed_graph<T, A>::insert(T&& node_value) {
         return { iterator{ iter, this }, false };
     }
     m_nodes.emplace_back(*this, std::move(node_value), m_allocator);
+    m_fingerprint += details::node_fingerprint(m_nodes.back().m_hash);
+    index_last_node();
     return { iterator{ --std::end(m_nodes), this }, true };
 }
 
+template<typename T, typename A>
+void directed_graph<T, A>::index_last_node() {
+    if constexpr (details::hashable<T>) {
+        m_valueIndex.emplace(m_nodes.back().m_hash, m_nodes.size() - 1);
+    }
+}
+
+template<typename T, typename A>
+void directed_graph<T, A>::rebuild_value_index() {
+    if constexpr (details::hashable<T>) {
+        m_valueIndex.clear();
+        for (size_type index{ 0 }; index < m_nodes.size(); ++index) {
+            m_valueIndex.emplace(m_nodes[index].m_hash, index);
+        }
+    }
+}
+
+template<typename T, typename A>
+void directed_graph<T, A>::rebuild_indices() {
+    rebuild_value_index();
+    for (auto&& node: m_nodes) { node.m_inDegree = 0; }
+    for (auto&& node: m_nodes) {
+        for (auto&& to: node.get_adjacent_nodes_indices()) {
+            ++m_nodes[to].m_inDegree;
+        }
+    }
+}
+
 template<typename T, typename A>
 std::pair<typename directed_graph<T, A>::iterator, bool>
 directed_graph<T, A>::insert(const T& node_value) {
@@ -454,8 +638,23 @@ bool directed_graph<T, A>::insert_edge(const T& from_node_value,
     const auto from{ findNode(from_node_value) };
     const auto to{ findNode(to_node_value) };
     if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
-    const size_t to_index{ get_index_of_node(to) };
-    return from->get_adjacent_nodes_indices().insert(to_index).second;
+    return insert_edge(node_id{ get_index_of_node(from) },
+                       node_id{ get_index_of_node(to) });
+}
+
+template<typename T, typename A>
+bool directed_graph<T, A>::insert_edge(node_id from, node_id to) {
+    if (from.index >= m_nodes.size() || to.index >= m_nodes.size()) {
+        return false;
+    }
+    auto& from_node{ m_nodes[from.index] };
+    if (!from_node.get_adjacent_nodes_indices().insert(to.index).second) {
+        return false;
+    }
+    ++m_nodes[to.index].m_inDegree;
+    m_fingerprint += details::edge_fingerprint(from_node.m_hash,
+                                               m_nodes[to.index].m_hash);
+    return true;
 }
 
 template<typename T, typename A>
@@ -470,11 +669,21 @@ void directed_graph<T, A>::remove_all_links_to(
     typename nodes_container_type::const_iterator node_iter) {
     const size_t node_index{ get_index_of_node(node_iter) };
 
+    // Take the node and its out-edges out of the fingerprint
+    const auto node_hash{ node_iter->m_hash };
+    m_fingerprint -= details::node_fingerprint(node_hash);
+    for (auto&& index: node_iter->get_adjacent_nodes_indices()) {
+        m_fingerprint -=
+            details::edge_fingerprint(node_hash, m_nodes[index].m_hash);
+    }
+
     // Iterate over all adjacency lists of all nodes
     for (auto&& node: m_nodes) {
         auto& adjacencyIndices{ node.get_adjacent_nodes_indices() };
         // Remove references from to-be-deleted node
-        adjacencyIndices.erase(node_index);
+        if (adjacencyIndices.erase(node_index) != 0 && &node != &*node_iter) {
+            m_fingerprint -= details::edge_fingerprint(node.m_hash, node_hash);
+        }
         // Modify adjacency indices to account for deletion
         // Some inefficiency, as data is converted to a vector,
         // indices are adjusted, and the set is wiped and rebuilt
@@ -496,6 +705,7 @@ bool directed_graph<T, A>::erase(const T& node_value) {
     if (iter == std::end(m_nodes)) { return false; }
     remove_all_links_to(iter);
     m_nodes.erase(iter);
+    rebuild_indices();
     return true;
 }
 
@@ -506,19 +716,25 @@ directed_graph<T, A>::erase(const_iterator pos) {
         return iterator{ std::end(m_nodes), this };
     }
     remove_all_links_to(pos.m_nodeIterator);
-    return iterator{ m_nodes.erase(pos.m_nodeIterator), this };
+    const auto next{ m_nodes.erase(pos.m_nodeIterator) };
+    rebuild_indices();
+    return iterator{ next, this };
 }
 
 template<typename T, typename A>
 typename directed_graph<T, A>::iterator
 directed_graph<T, A>::erase(const_iterator first, const_iterator last) {
-    for (auto iter{ first }; iter != last; ++iter) {
-        if (iter.m_nodeIterator != std::end(m_nodes)) {
-            remove_all_links_to(iter.m_nodeIterator);
-        }
+    // Erase back to front, so that removing each node only shifts the
+    // indices of nodes that have already been dealt with.
+    const auto first_index{ get_index_of_node(first.m_nodeIterator) };
+    for (auto index{ get_index_of_node(last.m_nodeIterator) };
+         index > first_index; --index) {
+        const auto node_iter{ std::begin(m_nodes) + (index - 1) };
+        remove_all_links_to(node_iter);
+        m_nodes.erase(node_iter);
     }
-    return iterator{ m_nodes.erase(first.m_nodeIterator, last.m_nodeIterator),
-                     this };
+    rebuild_indices();
+    return iterator{ std::begin(m_nodes) + first_index, this };
 }
 
 template<typename T, typename A>
@@ -527,14 +743,266 @@ bool directed_graph<T, A>::erase_edge(const T& from_node_value,
     const auto from{ findNode(from_node_value) };
     const auto to{ findNode(to_node_value) };
     if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
-    const size_t to_index{ get_index_of_node(to) };
-    from->get_adjacent_nodes_indices().erase(to_index);
+    return erase_edge(node_id{ get_index_of_node(from) },
+                      node_id{ get_index_of_node(to) });
+}
+
+template<typename T, typename A>
+bool directed_graph<T, A>::erase_edge(node_id from, node_id to) {
+    if (from.index >= m_nodes.size() || to.index >= m_nodes.size()) {
+        return false;
+    }
+    auto& from_node{ m_nodes[from.index] };
+    if (from_node.get_adjacent_nodes_indices().erase(to.index) == 0) {
+        return false;
+    }
+    --m_nodes[to.index].m_inDegree;
+    m_fingerprint -= details::edge_fingerprint(from_node.m_hash,
+                                               m_nodes[to.index].m_hash);
     return true;
 }
 
+template<typename T, typename A>
+bool directed_graph<T, A>::has_edge(const T& from_node_value,
+                                    const T& to_node_value) const {
+    const auto from{ findNode(from_node_value) };
+    const auto to{ findNode(to_node_value) };
+    if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
+    return has_edge(node_id{ get_index_of_node(from) },
+                    node_id{ get_index_of_node(to) });
+}
+
+template<typename T, typename A>
+bool directed_graph<T, A>::has_edge(node_id from, node_id to) const {
+    return from.index < m_nodes.size() &&
+           m_nodes[from.index].get_adjacent_nodes_indices().contains(to.index);
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::size_type
+directed_graph<T, A>::out_degree(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return 0; }
+    return iter->get_adjacent_nodes_indices().size();
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::size_type
+directed_graph<T, A>::in_degree(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return 0; }
+    return iter->m_inDegree;
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::size_type
+directed_graph<T, A>::out_degree(node_id node) const {
+    if (node.index >= m_nodes.size()) { return 0; }
+    return m_nodes[node.index].get_adjacent_nodes_indices().size();
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::size_type
+directed_graph<T, A>::in_degree(node_id node) const {
+    if (node.index >= m_nodes.size()) { return 0; }
+    return m_nodes[node.index].m_inDegree;
+}
+
+template<typename T, typename A>
+void directed_graph<T, A>::apply(const graph_batch<T>& batch,
+                                 thread_pool& pool) {
+    using edge_change = typename graph_batch<T>::edge_change;
+
+    // For hashable T this is index_of, over the value index that
+    // index_last_node() keeps current, so nothing is built per batch
+    details::value_lookup lookup{ *this };
+    for (auto&& node_value: batch.m_insertedNodes) {
+        if (lookup.find(node_value) != npos) { continue; }
+        m_nodes.emplace_back(*this, node_value, m_allocator);
+        m_fingerprint += details::node_fingerprint(m_nodes.back().m_hash);
+        index_last_node();
+        lookup.add(m_nodes.size() - 1);
+    }
+
+    // Resolve both ends of each edge change, dropping changes that refer
+    // to missing nodes
+    std::vector<edge_change> changes;
+    changes.reserve(batch.edge_change_count());
+    for (auto&& change: batch.m_valueEdges) {
+        const auto from{ lookup.find(change.from) };
+        const auto to{ lookup.find(change.to) };
+        if (from != npos && to != npos) {
+            changes.push_back({ from, to, change.sequence, change.insert });
+        }
+    }
+    for (auto&& change: batch.m_indexEdges) {
+        if (change.from < m_nodes.size() && change.to < m_nodes.size()) {
+            changes.push_back(change);
+        }
+    }
+    std::sort(std::begin(changes), std::end(changes),
+              [](const edge_change& a, const edge_change& b) {
+                  return std::tie(a.from, a.to, a.sequence) <
+                         std::tie(b.from, b.to, b.sequence);
+              });
+    apply_edge_changes(changes, pool);
+
+    if (batch.m_erasedNodes.empty()) { return; }
+    std::vector<size_type> remap(m_nodes.size(), 0);
+    bool erasing{ false };
+    for (auto&& node_value: batch.m_erasedNodes) {
+        const auto index{ lookup.find(node_value) };
+        if (index != npos) {
+            remap[index] = npos;
+            erasing = true;
+        }
+    }
+    if (!erasing) { return; }
+    size_type kept{ 0 };
+    for (auto&& index: remap) {
+        if (index != npos) { index = kept++; }
+    }
+    erase_nodes(remap, pool);
+}
+
+template<typename T, typename A>
+void directed_graph<T, A>::apply_edge_changes(
+    const std::vector<typename graph_batch<T>::edge_change>& changes,
+    thread_pool& pool) {
+    // Each group of changes with the same source is applied by one worker
+    std::vector<size_type> groups;
+    for (size_type i{ 0 }; i < changes.size(); ++i) {
+        if (i == 0 || changes[i].from != changes[i - 1].from) {
+            groups.push_back(i);
+        }
+    }
+    groups.push_back(changes.size());
+
+    std::vector<std::uint64_t> fingerprints(pool.size(), 0);
+    pool.parallel_for_chunks(
+        0, groups.size() - 1,
+        [&](size_type worker, size_type first_group, size_type last_group) {
+            for (auto group{ first_group }; group < last_group; ++group) {
+                const auto first{ groups[group] };
+                const auto last{ groups[group + 1] };
+                auto& from_node{ m_nodes[changes[first].from] };
+                auto& adjacency{ from_node.get_adjacent_nodes_indices() };
+
+                // Targets come in ascending order, so the list is merged
+                // with the changes in one forward pass. For a few changes
+                // to a long list, binary search beats stepping through it.
+                const bool step{ (last - first) *
+                                     std::bit_width(adjacency.size()) >=
+                                 adjacency.size() };
+                auto position{ std::begin(adjacency) };
+                for (auto i{ first }; i < last; ++i) {
+                    // Only the last change to each edge counts
+                    const auto to{ changes[i].to };
+                    if (i + 1 < last && changes[i + 1].to == to) { continue; }
+                    if (step) {
+                        while (position != std::end(adjacency) &&
+                               *position < to) {
+                            ++position;
+                        }
+                    } else {
+                        position = adjacency.lower_bound(to);
+                    }
+                    const bool present{ position != std::end(adjacency) &&
+                                        *position == to };
+                    const auto edge{ details::edge_fingerprint(
+                        from_node.m_hash, m_nodes[to].m_hash) };
+                    // A target can be shared with other workers' sources,
+                    // so its in-degree is counted atomically
+                    std::atomic_ref in_degree{ m_nodes[to].m_inDegree };
+                    if (changes[i].insert && !present) {
+                        position =
+                            std::next(adjacency.emplace_hint(position, to));
+                        fingerprints[worker] += edge;
+                        in_degree.fetch_add(1, std::memory_order_relaxed);
+                    } else if (!changes[i].insert && present) {
+                        position = adjacency.erase(position);
+                        fingerprints[worker] -= edge;
+                        in_degree.fetch_sub(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        },
+        64);
+    for (auto fingerprint: fingerprints) { m_fingerprint += fingerprint; }
+}
+
+template<typename T, typename A>
+void directed_graph<T, A>::erase_nodes(const std::vector<size_type>& remap,
+                                       thread_pool& pool) {
+    const auto first_erased{ static_cast<size_type>(
+        std::find(std::begin(remap), std::end(remap), npos) -
+        std::begin(remap)) };
+
+    // Drop edges to erased nodes and renumber the rest, in parallel. Each
+    // edge leaves the fingerprint exactly once: with its source if that is
+    // erased, and otherwise with its target.
+    std::vector<std::uint64_t> fingerprints(pool.size(), 0);
+    pool.parallel_for_chunks(
+        0, m_nodes.size(),
+        [&](size_type worker, size_type first, size_type last) {
+            std::vector<size_type> targets;
+            for (auto index{ first }; index < last; ++index) {
+                auto& node{ m_nodes[index] };
+                auto& adjacency{ node.get_adjacent_nodes_indices() };
+                if (remap[index] == npos) {
+                    fingerprints[worker] -=
+                        details::node_fingerprint(node.m_hash);
+                    for (auto&& to: adjacency) {
+                        fingerprints[worker] -= details::edge_fingerprint(
+                            node.m_hash, m_nodes[to].m_hash);
+                        // Only the in-degrees of kept nodes still matter
+                        if (remap[to] != npos) {
+                            std::atomic_ref{ m_nodes[to].m_inDegree }.fetch_sub(
+                                1, std::memory_order_relaxed);
+                        }
+                    }
+                    continue;
+                }
+                // Lists only pointing below the first erased node keep
+                // their indices
+                if (adjacency.empty() ||
+                    *std::rbegin(adjacency) < first_erased) {
+                    continue;
+                }
+                targets.clear();
+                for (auto&& to: adjacency) {
+                    if (remap[to] == npos) {
+                        fingerprints[worker] -= details::edge_fingerprint(
+                            node.m_hash, m_nodes[to].m_hash);
+                    } else {
+                        targets.push_back(remap[to]);
+                    }
+                }
+                // Renumbering keeps the targets sorted, so this is linear
+                adjacency = typename details::graph_node<
+                    T, A>::adjacency_list_type(std::begin(targets),
+                                               std::end(targets));
+            }
+        },
+        256);
+    for (auto fingerprint: fingerprints) { m_fingerprint += fingerprint; }
+
+    // Close the gaps, moving nodes down as vector::erase would
+    size_type kept{ 0 };
+    for (size_type index{ 0 }; index < m_nodes.size(); ++index) {
+        if (remap[index] == npos) { continue; }
+        if (kept != index) { m_nodes[kept] = std::move(m_nodes[index]); }
+        ++kept;
+    }
+    m_nodes.erase(std::begin(m_nodes) + kept, std::end(m_nodes));
+    rebuild_value_index();
+}
+
 template<typename T, typename A>
 void directed_graph<T, A>::clear() noexcept {
     m_nodes.clear();
+    m_fingerprint = 0;
+    if constexpr (details::hashable<T>) { m_valueIndex.clear(); }
 }
 
 template<typename T, typename A>
@@ -542,12 +1010,19 @@ void directed_graph<T, A>::swap(directed_graph& other_graph) noexcept {
     using std::swap;
     m_nodes.swap(other_graph.m_nodes);
     swap(m_allocator, other_graph.m_allocator);
+    swap(m_fingerprint, other_graph.m_fingerprint);
+    swap(m_valueIndex, other_graph.m_valueIndex);
 }
 
 template<typename T, typename A>
-typename directed_graph<T, A>::reference
-directed_graph<T, A>::operator[](size_t index) {
-    return m_nodes[index].value();
+std::uint64_t directed_graph<T, A>::fingerprint() const noexcept {
+    return m_fingerprint;
+}
+
+template<typename T, typename A>
+node_value_reference<directed_graph<T, A>>
+directed_graph<T, A>::operator[](size_type index) {
+    return { *this, index };
 }
 
 template<typename T, typename A>
@@ -557,9 +1032,11 @@ directed_graph<T, A>::operator[](size_type index) const {
 }
 
 template<typename T, typename A>
-typename directed_graph<T, A>::reference
+node_value_reference<directed_graph<T, A>>
 directed_graph<T, A>::at(size_type index) {
-    return m_nodes.at(index).value();
+    // Throws std::out_of_range like the const overload
+    static_cast<void>(m_nodes.at(index));
+    return { *this, index };
 }
 
 template<typename T, typename A>
@@ -569,21 +1046,65 @@ directed_graph<T, A>::at(directed_graph::size_type index) const {
 }
 
 template<typename T, typename A>
-bool directed_graph<T, A>::operator==(const directed_graph& rhs) const {
-    if (m_nodes.size() != rhs.m_nodes.size()) { return false; }
+bool directed_graph<T, A>::set_value(size_type index, T node_value) {
+    if (index >= m_nodes.size()) { return false; }
+    const auto existing{ findNode(node_value) };
+    if (existing != std::end(m_nodes)) {
+        return get_index_of_node(existing) == index;
+    }
 
-    for (auto&& node: m_nodes) {
-        const auto rhsNodeIter{ rhs.findNode(node.value()) };
-        if (rhsNodeIter == std::end(rhs.m_nodes)) { return false; }
-        const auto adjacent_values_lhs{ get_adjacent_nodes_values(
-            node.get_adjacent_nodes_indices()) };
-        const auto adjacent_values_rhs{ rhs.get_adjacent_nodes_values(
-            rhsNodeIter->get_adjacent_nodes_indices()) };
-        if (adjacent_values_lhs != adjacent_values_rhs) { return false; }
+    // Every edge at the node is hashed with its value, so all of them
+    // leave the fingerprint and come back with the new hash. A loop is
+    // among the out-edges, so it is left out of the in-edges.
+    auto& node{ m_nodes[index] };
+    std::vector<size_type> sources;
+    for (size_type from{ 0 }; node.m_inDegree != 0 && from < m_nodes.size();
+         ++from) {
+        if (from != index &&
+            m_nodes[from].get_adjacent_nodes_indices().contains(index)) {
+            sources.push_back(from);
+        }
+    }
+    const auto contribution{ [&] {
+        auto sum{ details::node_fingerprint(node.m_hash) };
+        for (auto&& to: node.get_adjacent_nodes_indices()) {
+            sum += details::edge_fingerprint(node.m_hash, m_nodes[to].m_hash);
+        }
+        for (auto from: sources) {
+            sum +=
+                details::edge_fingerprint(m_nodes[from].m_hash, node.m_hash);
+        }
+        return sum;
+    } };
+    const auto old_contribution{ contribution() };
+    const auto old_hash{ node.m_hash };
+    node.value() = std::move(node_value);
+    node.m_hash = details::hash_value(node.value());
+    m_fingerprint += contribution() - old_contribution;
+
+    if constexpr (details::hashable<T>) {
+        const auto [first, last]{ m_valueIndex.equal_range(old_hash) };
+        m_valueIndex.erase(std::find_if(first, last, [index](auto&& entry) {
+            return entry.second == index;
+        }));
+        m_valueIndex.emplace(node.m_hash, index);
     }
     return true;
 }
 
+template<typename T, typename A>
+bool directed_graph<T, A>::operator==(const directed_graph& rhs) const {
+    // Differing fingerprints are a cheap way to rule out equality
+    if (m_fingerprint != rhs.m_fingerprint) { return false; }
+    return !first_difference(rhs);
+}
+
+template<typename T, typename A>
+std::optional<graph_difference>
+directed_graph<T, A>::first_difference(const directed_graph& rhs) const {
+    return details::first_difference(*this, rhs);
+}
+
 template<typename T, typename A>
 std::set<T, std::less<>, A> directed_graph<T, A>::get_adjacent_nodes_values(
     const typename details::graph_node<T, A>::adjacency_list_type& indices)
@@ -608,6 +1129,46 @@ directed_graph<T, A>::get_adjacent_nodes_values(const T& node_value) const {
     return get_adjacent_nodes_values(iter->get_adjacent_nodes_indices());
 }
 
+template<typename T, typename A>
+iterator_range<typename directed_graph<T, A>::const_iterator_adjacent_nodes>
+directed_graph<T, A>::adjacent_nodes(const T& node_value) const {
+    auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return {}; }
+    const auto& indices{ iter->get_adjacent_nodes_indices() };
+    return { const_iterator_adjacent_nodes{ std::cbegin(indices), this },
+             const_iterator_adjacent_nodes{ std::cend(indices), this } };
+}
+
+template<typename T, typename A>
+iterator_range<typename directed_graph<T, A>::const_iterator_adjacent_indices>
+directed_graph<T, A>::adjacent_node_indices(const T& node_value) const {
+    auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return {}; }
+    const auto& indices{ iter->get_adjacent_nodes_indices() };
+    return { std::cbegin(indices), std::cend(indices) };
+}
+
+template<typename T, typename A>
+iterator_range<typename directed_graph<T, A>::const_iterator_adjacent_indices>
+directed_graph<T, A>::out_edges(size_type index) const {
+    const auto& indices{ m_nodes[index].get_adjacent_nodes_indices() };
+    return { std::cbegin(indices), std::cend(indices) };
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::const_reference
+directed_graph<T, A>::value(size_type index) const {
+    return m_nodes[index].value();
+}
+
+template<typename T, typename A>
+typename directed_graph<T, A>::size_type
+directed_graph<T, A>::index_of(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return npos; }
+    return get_index_of_node(iter);
+}
+
 template<typename T, typename A>
 typename directed_graph<T, A>::size_type
 directed_graph<T, A>::size() const noexcept {
@@ -1109,16 +1670,17 @@ public:
     using value_type = typename GraphType::value_type;
     using difference_type = ptrdiff_t;
     using iterator_category = std::bidirectional_iterator_tag;
-    using pointer = value_type*;
-    using reference = value_type&;
+    // Values are written through a node_value_reference, which calls the
+    // graph's set_value(), so -> only gives read access
+    using pointer = const value_type*;
+    using reference = node_value_reference<GraphType>;
     using iterator_type = std::set<size_t>::iterator;
 
     adjacent_nodes_iterator() = default;
 
     adjacent_nodes_iterator(iterator_type it, const GraphType* graph);
 
-    reference operator*();
-    pointer operator->();
+    reference operator*() const;
 
     adjacent_nodes_iterator& operator++();
     adjacent_nodes_iterator operator++(int);
@@ -1133,16 +1695,10 @@ adjacent_nodes_iterator<GraphType>::adjacent_nodes_iterator(
 
 template<typename GraphType>
 typename adjacent_nodes_iterator<GraphType>::reference
-adjacent_nodes_iterator<GraphType>::operator*() {
-    return const_cast<reference>(
-        (*(this->m_graph))[*(this->m_adjacentNodeIterator)]);
-}
-
-template<typename GraphType>
-typename adjacent_nodes_iterator<GraphType>::pointer
-adjacent_nodes_iterator<GraphType>::operator->() {
-    return const_cast<pointer>(
-        &((*(this->m_graph))[*(this->m_adjacentNodeIterator)]));
+adjacent_nodes_iterator<GraphType>::operator*() const {
+    // Only the graph's non-const begin() and end() hand these out
+    return { const_cast<GraphType&>(*(this->m_graph)),
+             *(this->m_adjacentNodeIterator) };
 }
 
 template<typename GraphType>
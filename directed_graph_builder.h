@@ -0,0 +1,197 @@
+//
+// Parallel bulk edge insertion for directed_graph.
+//
+#pragma once
+
+#include "directed_graph.h"
+#include "graph_common.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Lets many threads add edges to a directed_graph at once, during initial
+// construction. The graph's nodes must all be inserted before the builder
+// is created, and the graph must not be used until finalize() is called.
+//
+// Each thread asks for its own edge_buffer once, and then appends to it
+// without any locking or atomics. finalize() distributes the buffered edges
+// to their source nodes, sorts and de-duplicates each node's targets, and
+// merges them into the graph, spread over a thread pool.
+template<typename T, typename A = std::allocator<T>>
+class directed_graph_builder {
+public:
+    using size_type = size_t;
+
+    // A per-thread edge buffer. Must only be used by one thread at a time.
+    class edge_buffer {
+    public:
+        // Returns false if either node is not in the graph
+        bool insert_edge(node_id from, node_id to);
+
+        bool insert_edge(const T& from_node_value, const T& to_node_value)
+            requires details::hashable<T>;
+
+    private:
+        friend class directed_graph_builder;
+
+        explicit edge_buffer(const directed_graph_builder& builder);
+
+        const directed_graph_builder* m_builder;
+        std::vector<std::pair<size_type, size_type>> m_edges;
+    };
+
+    explicit directed_graph_builder(directed_graph<T, A>& graph);
+
+    // Returns a new buffer for the calling thread. The buffer stays valid
+    // until finalize() is called.
+    [[nodiscard]] edge_buffer& make_buffer();
+
+    // Merges all buffered edges into the graph and empties the buffers.
+    // Returns the number of edges that were new to the graph.
+    size_type finalize(thread_pool& pool = default_thread_pool());
+
+private:
+    directed_graph<T, A>& m_graph;
+    size_type m_nodeCount;
+
+    std::mutex m_buffersMutex;
+    // A deque, so handing out a new buffer never moves existing ones
+    std::deque<edge_buffer> m_buffers;
+
+    // Value to index lookup, built once up front so that buffers can read
+    // it concurrently
+    std::conditional_t<details::hashable<T>,
+                       std::unordered_map<T, size_type>, std::monostate>
+        m_indices;
+};
+
+template<typename T, typename A>
+directed_graph_builder<T, A>::edge_buffer::edge_buffer(
+    const directed_graph_builder& builder)
+    : m_builder{ &builder } {}
+
+template<typename T, typename A>
+bool directed_graph_builder<T, A>::edge_buffer::insert_edge(node_id from,
+                                                            node_id to) {
+    if (from.index >= m_builder->m_nodeCount ||
+        to.index >= m_builder->m_nodeCount) {
+        return false;
+    }
+    m_edges.emplace_back(from.index, to.index);
+    return true;
+}
+
+template<typename T, typename A>
+bool directed_graph_builder<T, A>::edge_buffer::insert_edge(
+    const T& from_node_value, const T& to_node_value)
+    requires details::hashable<T>
+{
+    const auto& indices{ m_builder->m_indices };
+    const auto from{ indices.find(from_node_value) };
+    const auto to{ indices.find(to_node_value) };
+    if (from == std::end(indices) || to == std::end(indices)) { return false; }
+    m_edges.emplace_back(from->second, to->second);
+    return true;
+}
+
+template<typename T, typename A>
+directed_graph_builder<T, A>::directed_graph_builder(
+    directed_graph<T, A>& graph)
+    : m_graph{ graph }, m_nodeCount{ graph.size() } {
+    if constexpr (details::hashable<T>) {
+        m_indices.reserve(m_nodeCount);
+        for (size_type i{ 0 }; i < m_nodeCount; ++i) {
+            m_indices.emplace(graph.value(i), i);
+        }
+    }
+}
+
+template<typename T, typename A>
+typename directed_graph_builder<T, A>::edge_buffer&
+directed_graph_builder<T, A>::make_buffer() {
+    std::scoped_lock lock{ m_buffersMutex };
+    return m_buffers.emplace_back(edge_buffer{ *this });
+}
+
+template<typename T, typename A>
+typename directed_graph_builder<T, A>::size_type
+directed_graph_builder<T, A>::finalize(thread_pool& pool) {
+    // Count the edges from each node, then lay them out contiguously by
+    // source (a counting sort), with each buffer scattered by one worker
+    std::vector<std::atomic<size_type>> offsets(m_nodeCount + 1);
+    pool.parallel_for(
+        0, m_buffers.size(),
+        [this, &offsets](size_type b) {
+            for (auto&& [from, to]: m_buffers[b].m_edges) {
+                offsets[from + 1].fetch_add(1, std::memory_order_relaxed);
+            }
+        },
+        1);
+    for (size_type i{ 1 }; i <= m_nodeCount; ++i) {
+        offsets[i].store(offsets[i].load() + offsets[i - 1].load());
+    }
+    std::vector<size_type> targets(offsets[m_nodeCount].load());
+    {
+        std::vector<std::atomic<size_type>> cursors(m_nodeCount);
+        for (size_type i{ 0 }; i < m_nodeCount; ++i) {
+            cursors[i].store(offsets[i].load());
+        }
+        pool.parallel_for(
+            0, m_buffers.size(),
+            [this, &cursors, &targets](size_type b) {
+                for (auto&& [from, to]: m_buffers[b].m_edges) {
+                    targets[cursors[from].fetch_add(
+                        1, std::memory_order_relaxed)] = to;
+                }
+                m_buffers[b].m_edges = {};
+            },
+            1);
+    }
+
+    // Each node's list is sorted, de-duplicated and merged into its
+    // adjacency list independently. Per-worker totals avoid sharing a
+    // counter between workers, but in-degrees are shared between sources
+    // and so are counted atomically.
+    std::vector<size_type> inserted(pool.size(), 0);
+    std::vector<std::uint64_t> fingerprints(pool.size(), 0);
+    auto& nodes{ m_graph.m_nodes };
+    pool.parallel_for_chunks(
+        0, m_nodeCount,
+        [&](size_type worker, size_type first, size_type last) {
+            for (auto from{ first }; from < last; ++from) {
+                const auto begin{ std::begin(targets) + offsets[from] };
+                const auto end{ std::begin(targets) + offsets[from + 1] };
+                std::sort(begin, end);
+                const auto unique_end{ std::unique(begin, end) };
+                auto& adjacency{ nodes[from].get_adjacent_nodes_indices() };
+                for (auto iter{ begin }; iter != unique_end; ++iter) {
+                    // Targets arrive in order, so hint at the end of the set
+                    const auto before{ adjacency.size() };
+                    adjacency.insert(std::end(adjacency), *iter);
+                    if (adjacency.size() != before) {
+                        ++inserted[worker];
+                        fingerprints[worker] += details::edge_fingerprint(
+                            nodes[from].m_hash, nodes[*iter].m_hash);
+                        std::atomic_ref{ nodes[*iter].m_inDegree }.fetch_add(
+                            1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        },
+        256);
+
+    m_buffers.clear();
+    for (auto fingerprint: fingerprints) {
+        m_graph.m_fingerprint += fingerprint;
+    }
+    size_type total{ 0 };
+    for (auto count: inserted) { total += count; }
+    return total;
+}
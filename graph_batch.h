@@ -0,0 +1,138 @@
+//
+// A batch of changes to apply to a directed_graph in one go.
+//
+#pragma once
+
+#include "graph_common.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+template<typename T, typename A>
+class directed_graph;
+
+// Records node and edge insertions and erasures for directed_graph::apply.
+// Recording a change does no lookups: values are resolved to nodes once per
+// batch, when it is applied.
+template<typename T>
+class graph_batch {
+public:
+    using value_type = T;
+    using size_type = size_t;
+
+    void insert(const T& node_value);
+
+    void insert(T&& node_value);
+
+    void erase(const T& node_value);
+
+    void insert_edge(const T& from_node_value, const T& to_node_value);
+
+    // Node ids are the node indices at the time the batch is applied, which
+    // nodes inserted by the batch don't change
+    void insert_edge(node_id from, node_id to);
+
+    void erase_edge(const T& from_node_value, const T& to_node_value);
+
+    void erase_edge(node_id from, node_id to);
+
+    // Removes all recorded changes
+    void clear() noexcept;
+
+    // Number of recorded changes
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+private:
+    template<typename, typename>
+    friend class directed_graph;
+
+    // An edge change with its ends resolved to node indices. The sequence
+    // number orders changes to the same edge.
+    struct edge_change {
+        size_type from;
+        size_type to;
+        size_type sequence;
+        bool insert;
+    };
+
+    struct value_edge_change {
+        T from;
+        T to;
+        size_type sequence;
+        bool insert;
+    };
+
+    std::vector<T> m_insertedNodes;
+    std::vector<T> m_erasedNodes;
+    std::vector<value_edge_change> m_valueEdges;
+    std::vector<edge_change> m_indexEdges;
+
+    [[nodiscard]] size_type edge_change_count() const noexcept;
+};
+
+template<typename T>
+void graph_batch<T>::insert(const T& node_value) {
+    m_insertedNodes.push_back(node_value);
+}
+
+template<typename T>
+void graph_batch<T>::insert(T&& node_value) {
+    m_insertedNodes.push_back(std::move(node_value));
+}
+
+template<typename T>
+void graph_batch<T>::erase(const T& node_value) {
+    m_erasedNodes.push_back(node_value);
+}
+
+template<typename T>
+void graph_batch<T>::insert_edge(const T& from_node_value,
+                                 const T& to_node_value) {
+    m_valueEdges.push_back(
+        { from_node_value, to_node_value, edge_change_count(), true });
+}
+
+template<typename T>
+void graph_batch<T>::insert_edge(node_id from, node_id to) {
+    m_indexEdges.push_back(
+        { from.index, to.index, edge_change_count(), true });
+}
+
+template<typename T>
+void graph_batch<T>::erase_edge(const T& from_node_value,
+                                const T& to_node_value) {
+    m_valueEdges.push_back(
+        { from_node_value, to_node_value, edge_change_count(), false });
+}
+
+template<typename T>
+void graph_batch<T>::erase_edge(node_id from, node_id to) {
+    m_indexEdges.push_back(
+        { from.index, to.index, edge_change_count(), false });
+}
+
+template<typename T>
+void graph_batch<T>::clear() noexcept {
+    m_insertedNodes.clear();
+    m_erasedNodes.clear();
+    m_valueEdges.clear();
+    m_indexEdges.clear();
+}
+
+template<typename T>
+typename graph_batch<T>::size_type graph_batch<T>::size() const noexcept {
+    return m_insertedNodes.size() + m_erasedNodes.size() + edge_change_count();
+}
+
+template<typename T>
+bool graph_batch<T>::empty() const noexcept {
+    return size() == 0;
+}
+
+template<typename T>
+typename graph_batch<T>::size_type
+graph_batch<T>::edge_change_count() const noexcept {
+    return m_valueEdges.size() + m_indexEdges.size();
+}
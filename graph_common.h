@@ -0,0 +1,374 @@
+//
+// Helpers shared by directed_graph and weighted_directed_graph.
+//
+#pragma once
+
+#include <algorithm>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Position of a node in a graph, as used by operator[]. Index-based
+// overloads take a node_id rather than a bare size_t so that they can't be
+// confused with the value-based ones when T is itself an integer type.
+struct node_id {
+    std::size_t index;
+
+    auto operator<=>(const node_id&) const = default;
+};
+
+// A non-owning [begin, end) pair of iterators. The graphs hand these out so
+// that adjacency lists can be walked with a range-for without first being
+// copied into a new container. Like any iterator, a range is invalidated by
+// modifications to the graph it came from.
+template<typename Iter>
+class iterator_range {
+public:
+    using iterator = Iter;
+
+    iterator_range() = default;
+
+    iterator_range(Iter first, Iter last);
+
+    [[nodiscard]] Iter begin() const { return m_begin; }
+
+    [[nodiscard]] Iter end() const { return m_end; }
+
+    [[nodiscard]] bool empty() const { return m_begin == m_end; }
+
+private:
+    Iter m_begin{};
+    Iter m_end{};
+};
+
+template<typename Iter>
+iterator_range<Iter>::iterator_range(Iter first, Iter last)
+    : m_begin{ first }, m_end{ last } {}
+
+// Writable reference to the value of a node, handed out by the non-const
+// accessors of the graphs. Nodes are indexed by the hashes of their values,
+// so assigning through it calls the graph's set_value(), which keeps the
+// value index and fingerprint current. Like set_value(), an assignment of a
+// value that another node already has is ignored. Otherwise it reads like
+// a const reference to the value.
+template<typename GraphType>
+class node_value_reference {
+public:
+    using value_type = typename GraphType::value_type;
+
+    node_value_reference(GraphType& graph, std::size_t index) noexcept;
+
+    node_value_reference(const node_value_reference&) = default;
+
+    // Assigns the value rhs refers to, rather than rebinding
+    node_value_reference& operator=(const node_value_reference& rhs);
+
+    node_value_reference& operator=(value_type node_value);
+
+    operator const value_type&() const noexcept;
+
+    [[nodiscard]] const value_type& get() const noexcept;
+
+    friend bool operator==(const node_value_reference& lhs,
+                           const value_type& rhs) {
+        return lhs.get() == rhs;
+    }
+
+    template<typename CharT, typename Traits>
+    friend std::basic_ostream<CharT, Traits>&
+    operator<<(std::basic_ostream<CharT, Traits>& os,
+               const node_value_reference& ref) {
+        return os << ref.get();
+    }
+
+private:
+    GraphType* m_graph;
+    std::size_t m_index;
+};
+
+template<typename GraphType>
+node_value_reference<GraphType>::node_value_reference(
+    GraphType& graph, std::size_t index) noexcept
+    : m_graph{ &graph }, m_index{ index } {}
+
+template<typename GraphType>
+node_value_reference<GraphType>&
+node_value_reference<GraphType>::operator=(const node_value_reference& rhs) {
+    return *this = value_type{ rhs.get() };
+}
+
+template<typename GraphType>
+node_value_reference<GraphType>&
+node_value_reference<GraphType>::operator=(value_type node_value) {
+    m_graph->set_value(m_index, std::move(node_value));
+    return *this;
+}
+
+template<typename GraphType>
+node_value_reference<GraphType>::operator const value_type&() const noexcept {
+    return get();
+}
+
+template<typename GraphType>
+const typename node_value_reference<GraphType>::value_type&
+node_value_reference<GraphType>::get() const noexcept {
+    return m_graph->value(m_index);
+}
+
+// Describes the first way in which a graph was found to differ from another.
+// Indices refer to nodes in the graph that first_difference was called on.
+struct graph_difference {
+    enum class kind {
+        node_count,  // The graphs have different numbers of nodes
+        missing_node,// Node `from` has no equal in the other graph
+        missing_edge,// The edge `from` -> `to` is not in the other graph
+        out_degree,  // Node `from` has more out-edges in the other graph
+        edge_weight, // The edge `from` -> `to` has another weight in the
+                     // other graph
+    };
+
+    kind what;
+    std::size_t from;
+    std::size_t to;
+};
+
+namespace details {
+    template<typename T>
+    concept hashable = requires(const T& t) {
+        { std::hash<T>{}(t) } -> std::convertible_to<std::size_t>;
+    };
+
+    template<typename T>
+    concept less_than_comparable = requires(const T& a, const T& b) {
+        { a < b } -> std::convertible_to<bool>;
+    };
+
+    // Hash of a node value, or 0 for types without a std::hash
+    // specialisation, whose fingerprints then only reflect the shape of
+    // the graph.
+    template<typename T>
+    std::uint64_t hash_value(const T& value) {
+        if constexpr (hashable<T>) {
+            return std::hash<T>{}(value);
+        } else {
+            return 0;
+        }
+    }
+
+    // The splitmix64 finalizer. Spreads the bits of a hash so that sums of
+    // hashes don't cancel out in structured ways.
+    constexpr std::uint64_t mix_hash(std::uint64_t h) {
+        h += 0x9e3779b97f4a7c15;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+        return h ^ (h >> 31);
+    }
+
+    // Contributions of a node and of an edge to a graph's fingerprint,
+    // given the hashes of the node values involved. A graph's fingerprint
+    // is the sum of these over all its nodes and edges, which doesn't
+    // depend on insertion order and can be updated in O(1) per change.
+    constexpr std::uint64_t node_fingerprint(std::uint64_t node_hash) {
+        return mix_hash(node_hash);
+    }
+
+    constexpr std::uint64_t edge_fingerprint(std::uint64_t from_hash,
+                                             std::uint64_t to_hash) {
+        return mix_hash(mix_hash(from_hash ^ 0x5bd1e9955bd1e995) + to_hash);
+    }
+
+    inline std::uint64_t weighted_edge_fingerprint(std::uint64_t from_hash,
+                                                   std::uint64_t to_hash,
+                                                   double weight) {
+        return mix_hash(edge_fingerprint(from_hash, to_hash) ^
+                        std::hash<double>{}(weight));
+    }
+
+    template<typename Edge>
+    concept weighted_edge = requires(const Edge& edge) {
+        { edge.weight() } -> std::convertible_to<double>;
+    };
+
+    // Index from the hashes of node values to node positions, so that the
+    // graphs can find a node by value in O(1). Types without std::hash get
+    // no index, and are found by a linear search.
+    template<typename T>
+    using value_index_type =
+        std::conditional_t<hashable<T>,
+                           std::unordered_multimap<std::uint64_t, std::size_t>,
+                           std::monostate>;
+
+    // Target node index of an out-edge, whether the adjacency list holds
+    // bare indices or edge objects
+    template<typename Edge>
+    std::size_t edge_target(const Edge& edge) {
+        if constexpr (std::is_integral_v<Edge>) {
+            return edge;
+        } else {
+            return edge.index();
+        }
+    }
+
+    // Finds node indices by value, for a run of lookups against one graph.
+    // When T is hashable, this is the graph's own index_of, which goes
+    // through the value index the graph keeps current, so nothing is built.
+    // When T is only ordered, the node indices are sorted by value once and
+    // binary searched, rather than searching the nodes for each value.
+    // Otherwise every lookup is the graph's linear index_of.
+    template<typename Graph>
+    class value_lookup {
+    public:
+        using value_type = typename Graph::value_type;
+
+        explicit value_lookup(const Graph& graph);
+
+        // Returns the index of the node with value, or npos if there is
+        // no such node
+        [[nodiscard]] std::size_t find(const value_type& value) const;
+
+        // Makes the node at index findable, after it has been inserted into
+        // the graph
+        void add(std::size_t index);
+
+    private:
+        static constexpr bool sorted{ !hashable<value_type> &&
+                                      less_than_comparable<value_type> };
+
+        const Graph* m_graph;
+
+        // Node indices sorted by value, if they are kept
+        std::conditional_t<sorted, std::vector<std::size_t>, std::monostate>
+            m_indices;
+
+        [[nodiscard]] auto sorted_position(const value_type& value) const;
+    };
+
+    template<typename Graph>
+    value_lookup<Graph>::value_lookup(const Graph& graph) : m_graph{ &graph } {
+        if constexpr (sorted) {
+            m_indices.resize(graph.size());
+            std::iota(std::begin(m_indices), std::end(m_indices),
+                      std::size_t{ 0 });
+            std::sort(std::begin(m_indices), std::end(m_indices),
+                      [&graph](std::size_t a, std::size_t b) {
+                          return graph.value(a) < graph.value(b);
+                      });
+        }
+    }
+
+    template<typename Graph>
+    auto value_lookup<Graph>::sorted_position(const value_type& value) const {
+        return std::lower_bound(std::begin(m_indices), std::end(m_indices),
+                                value,
+                                [this](std::size_t a, const value_type& v) {
+                                    return m_graph->value(a) < v;
+                                });
+    }
+
+    template<typename Graph>
+    std::size_t value_lookup<Graph>::find(const value_type& value) const {
+        if constexpr (sorted) {
+            const auto iter{ sorted_position(value) };
+            if (iter != std::end(m_indices) &&
+                m_graph->value(*iter) == value) {
+                return *iter;
+            }
+            return Graph::npos;
+        } else {
+            return m_graph->index_of(value);
+        }
+    }
+
+    template<typename Graph>
+    void value_lookup<Graph>::add(std::size_t index) {
+        if constexpr (sorted) {
+            m_indices.insert(sorted_position(m_graph->value(index)), index);
+        }
+    }
+
+    // Returns, for each node of `from`, the index of the node with an equal
+    // value in `to`, or npos if there isn't one. Linear when T is hashable,
+    // O(V log V) when it is only ordered, and quadratic otherwise.
+    template<typename Graph>
+    std::vector<std::size_t> match_nodes(const Graph& from, const Graph& to) {
+        const value_lookup lookup{ to };
+        std::vector<std::size_t> matches(from.size());
+        for (std::size_t i{ 0 }; i < from.size(); ++i) {
+            matches[i] = lookup.find(from.value(i));
+        }
+        return matches;
+    }
+
+    // Shared implementation of first_difference for both graph types. Each
+    // node's out-edges are compared by stamping the matched node's targets
+    // in `rhs` and then checking the node's own targets against the stamps,
+    // so the whole comparison is O(V + E) after matching up the nodes.
+    // Repeated targets (parallel edges) count once. Edge weights, where
+    // there are any, are recorded alongside the stamps and must match.
+    template<typename Graph>
+    std::optional<graph_difference> first_difference(const Graph& lhs,
+                                                     const Graph& rhs) {
+        using kind = graph_difference::kind;
+        constexpr auto npos{ Graph::npos };
+        if (lhs.size() != rhs.size()) {
+            return graph_difference{ kind::node_count, npos, npos };
+        }
+
+        const auto matches{ match_nodes(lhs, rhs) };
+        for (std::size_t i{ 0 }; i < matches.size(); ++i) {
+            if (matches[i] == npos) {
+                return graph_difference{ kind::missing_node, i, npos };
+            }
+        }
+
+        using edge_type =
+            std::remove_cvref_t<decltype(*std::begin(rhs.out_edges(0)))>;
+        constexpr bool weighted{ weighted_edge<edge_type> };
+        std::vector<std::size_t> stamps(rhs.size(), npos);
+        std::vector<double> weights(weighted ? rhs.size() : 0);
+        for (std::size_t i{ 0 }; i < lhs.size(); ++i) {
+            std::size_t rhsTargets{ 0 };
+            for (auto&& edge: rhs.out_edges(matches[i])) {
+                auto& stamp{ stamps[edge_target(edge)] };
+                if (stamp != i) {
+                    stamp = i;
+                    ++rhsTargets;
+                }
+                if constexpr (weighted) {
+                    weights[edge_target(edge)] = edge.weight();
+                }
+            }
+            std::size_t lhsTargets{ 0 };
+            std::size_t previous{ npos };
+            for (auto&& edge: lhs.out_edges(i)) {
+                const auto target{ edge_target(edge) };
+                if (target == previous) { continue; }
+                previous = target;
+                ++lhsTargets;
+                if (stamps[matches[target]] != i) {
+                    return graph_difference{ kind::missing_edge, i, target };
+                }
+                if constexpr (weighted) {
+                    if (weights[matches[target]] != edge.weight()) {
+                        return graph_difference{ kind::edge_weight, i, target };
+                    }
+                }
+            }
+            if (lhsTargets != rhsTargets) {
+                return graph_difference{ kind::out_degree, i, npos };
+            }
+        }
+        return std::nullopt;
+    }
+}// namespace details
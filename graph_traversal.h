@@ -0,0 +1,682 @@
+//
+// Breadth-first and depth-first traversals over node indices.
+//
+#pragma once
+
+#include "compressed_graph.h"
+#include "graph_common.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace details {
+    // A fixed-size set of node indices, one bit per node, stored in 64-bit
+    // words so that whole words can be scanned or combined at once
+    class node_bitset {
+    public:
+        explicit node_bitset(std::size_t size = 0);
+
+        [[nodiscard]] bool test(std::size_t index) const;
+
+        void set(std::size_t index);
+
+        // Empties the set
+        void clear();
+
+        // Sets the bit for index, which other threads may be setting or
+        // reading at the same time. Returns true if this call set it.
+        bool atomic_set(std::size_t index);
+
+        // Reads the bit for index while other threads may be setting it
+        [[nodiscard]] bool atomic_test(std::size_t index);
+
+        [[nodiscard]] std::size_t word_count() const;
+
+        [[nodiscard]] std::uint64_t& word(std::size_t index);
+
+        [[nodiscard]] std::uint64_t word(std::size_t index) const;
+
+        // The bits of the word at index that stand for nodes in the set's
+        // range, which is all of them except in the last word
+        [[nodiscard]] std::uint64_t valid_bits(std::size_t index) const;
+
+    private:
+        std::size_t m_size;
+        std::vector<std::uint64_t> m_words;
+    };
+
+    inline node_bitset::node_bitset(std::size_t size)
+        : m_size{ size }, m_words((size + 63) / 64, 0) {}
+
+    inline bool node_bitset::test(std::size_t index) const {
+        return (m_words[index / 64] >> (index % 64)) & 1;
+    }
+
+    inline void node_bitset::set(std::size_t index) {
+        m_words[index / 64] |= std::uint64_t{ 1 } << (index % 64);
+    }
+
+    inline void node_bitset::clear() {
+        std::fill(std::begin(m_words), std::end(m_words), 0);
+    }
+
+    inline bool node_bitset::atomic_set(std::size_t index) {
+        const auto bit{ std::uint64_t{ 1 } << (index % 64) };
+        std::atomic_ref word{ m_words[index / 64] };
+        return (word.fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+    }
+
+    inline bool node_bitset::atomic_test(std::size_t index) {
+        std::atomic_ref word{ m_words[index / 64] };
+        return (word.load(std::memory_order_relaxed) >> (index % 64)) & 1;
+    }
+
+    inline std::size_t node_bitset::word_count() const {
+        return m_words.size();
+    }
+
+    inline std::uint64_t& node_bitset::word(std::size_t index) {
+        return m_words[index];
+    }
+
+    inline std::uint64_t node_bitset::word(std::size_t index) const {
+        return m_words[index];
+    }
+
+    inline std::uint64_t node_bitset::valid_bits(std::size_t index) const {
+        const auto bits_in_word{ std::min<std::size_t>(m_size - index * 64,
+                                                       64) };
+        return bits_in_word == 64 ? ~std::uint64_t{ 0 }
+                                  : (std::uint64_t{ 1 } << bits_in_word) - 1;
+    }
+
+    // Calls a traversal hook, which may return void, or bool to say whether
+    // the traversal should go on
+    template<typename Hook>
+    bool call_hook(Hook&& hook) {
+        if constexpr (std::is_void_v<std::invoke_result_t<Hook>>) {
+            hook();
+            return true;
+        } else {
+            return static_cast<bool>(hook());
+        }
+    }
+
+    // State of a depth-first search, shared by the searches from each root
+    template<typename Graph>
+    class dfs_state {
+    public:
+        explicit dfs_state(const Graph& graph);
+
+        // Searches from root, which must not have been discovered yet.
+        // Returns false if a hook stopped the search.
+        template<typename Visitor>
+        bool run(std::size_t root, Visitor& visitor);
+
+        [[nodiscard]] bool discovered(std::size_t node) const;
+
+    private:
+        using edge_iterator =
+            decltype(std::begin(std::declval<const Graph&>().out_edges(0)));
+
+        // A node being explored, and how far through its out-edges it is
+        struct frame {
+            std::size_t node;
+            edge_iterator next;
+            edge_iterator end;
+        };
+
+        const Graph& m_graph;
+        node_bitset m_discovered;
+        node_bitset m_finished;
+        std::vector<frame> m_stack;
+
+        template<typename Visitor>
+        bool discover(std::size_t node, Visitor& visitor);
+    };
+
+    template<typename Graph>
+    dfs_state<Graph>::dfs_state(const Graph& graph)
+        : m_graph{ graph }, m_discovered{ graph.size() },
+          m_finished{ graph.size() } {
+        // The stack can't get deeper than the number of nodes, so it never
+        // has to grow during the search
+        m_stack.reserve(graph.size());
+    }
+
+    template<typename Graph>
+    bool dfs_state<Graph>::discovered(std::size_t node) const {
+        return m_discovered.test(node);
+    }
+
+    template<typename Graph>
+    template<typename Visitor>
+    bool dfs_state<Graph>::discover(std::size_t node, Visitor& visitor) {
+        m_discovered.set(node);
+        const auto edges{ m_graph.out_edges(node) };
+        m_stack.push_back({ node, std::begin(edges), std::end(edges) });
+        if constexpr (requires { visitor.discover(node); }) {
+            return call_hook([&] { return visitor.discover(node); });
+        }
+        return true;
+    }
+
+    template<typename Graph>
+    template<typename Visitor>
+    bool dfs_state<Graph>::run(std::size_t root, Visitor& visitor) {
+        if (!discover(root, visitor)) { return false; }
+        while (!m_stack.empty()) {
+            auto& top{ m_stack.back() };
+            const auto from{ top.node };
+            if (top.next == top.end) {
+                m_finished.set(from);
+                m_stack.pop_back();
+                if constexpr (requires { visitor.finish(from); }) {
+                    if (!call_hook([&] { return visitor.finish(from); })) {
+                        return false;
+                    }
+                }
+                continue;
+            }
+            const auto to{ edge_target(*top.next) };
+            ++top.next;
+            if (!m_discovered.test(to)) {
+                if constexpr (requires { visitor.tree_edge(from, to); }) {
+                    if (!call_hook(
+                            [&] { return visitor.tree_edge(from, to); })) {
+                        return false;
+                    }
+                }
+                if (!discover(to, visitor)) { return false; }
+            } else if (!m_finished.test(to)) {
+                if constexpr (requires { visitor.back_edge(from, to); }) {
+                    if (!call_hook(
+                            [&] { return visitor.back_edge(from, to); })) {
+                        return false;
+                    }
+                }
+            } else {
+                if constexpr (requires {
+                                  visitor.forward_or_cross_edge(from, to);
+                              }) {
+                    if (!call_hook([&] {
+                            return visitor.forward_or_cross_edge(from, to);
+                        })) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Runs a bit-parallel BFS from each batch of up to 64 * Words sources,
+    // with batches spread over pool. Each node has a mask of the batch's
+    // sources that have reached it, of those that reached it at the last
+    // level, and of those that reach it at the next, so a single scan of a
+    // node's out-edges advances every search that is at it. Calls
+    // on_reach(source, bits, node, level) whenever the sources in
+    // [source, source + 64) for which bits are set first reach node, at
+    // level hops, and on_finish(source, count, seen) after each batch of
+    // sources [source, source + count), where seen[node] is the mask of
+    // those that reached node.
+    template<std::size_t Words, typename F, typename G>
+    void multi_source_bfs_batches(const compressed_graph& graph,
+                                  std::span<const std::size_t> sources,
+                                  thread_pool& pool, F&& on_reach,
+                                  G&& on_finish) {
+        using size_type = std::size_t;
+        using mask = std::array<std::uint64_t, Words>;
+        constexpr size_type batch_size{ 64 * Words };
+        const auto n{ graph.size() };
+        const auto batches{ (sources.size() + batch_size - 1) / batch_size };
+
+        // Per-worker masks. visit and next are left empty after each batch,
+        // so only seen needs clearing for the next.
+        struct scratch {
+            std::vector<mask> seen;
+            std::vector<mask> visit;
+            std::vector<mask> next;
+            std::vector<char> queued;
+            std::vector<size_type> frontier;
+            std::vector<size_type> next_frontier;
+        };
+        std::vector<scratch> scratches(pool.size());
+        pool.parallel_for_chunks(
+            0, batches,
+            [&](size_type worker, size_type first, size_type last) {
+                auto& [seen, visit, next, queued, frontier, next_frontier]{
+                    scratches[worker]
+                };
+                visit.resize(n);
+                next.resize(n);
+                queued.resize(n);
+                for (auto batch{ first }; batch < last; ++batch) {
+                    const auto base{ batch * batch_size };
+                    const auto batch_sources{ sources.subspan(
+                        base, std::min(batch_size, sources.size() - base)) };
+                    seen.assign(n, mask{});
+                    frontier.clear();
+                    // Each source has its own bit, so a node listed as more
+                    // than one source is seeded with all their bits but
+                    // only queued once
+                    for (size_type i{ 0 }; i < batch_sources.size(); ++i) {
+                        const auto node{ batch_sources[i] };
+                        const auto bit{ std::uint64_t{ 1 } << (i % 64) };
+                        if (seen[node] == mask{}) { frontier.push_back(node); }
+                        seen[node][i / 64] |= bit;
+                        visit[node][i / 64] |= bit;
+                        on_reach(base + i / 64 * 64, bit, node, size_type{ 0 });
+                    }
+
+                    for (size_type level{ 1 }; !frontier.empty(); ++level) {
+                        next_frontier.clear();
+                        for (auto node: frontier) {
+                            const auto& bits{ visit[node] };
+                            for (auto to: graph.out_edges(node)) {
+                                for (size_type w{ 0 }; w < Words; ++w) {
+                                    next[to][w] |= bits[w];
+                                }
+                                if (!queued[to]) {
+                                    queued[to] = 1;
+                                    next_frontier.push_back(to);
+                                }
+                            }
+                            visit[node] = mask{};
+                        }
+
+                        // Keep only the sources that hadn't reached each
+                        // node yet, and the nodes some source reached
+                        frontier.clear();
+                        for (auto node: next_frontier) {
+                            queued[node] = 0;
+                            std::uint64_t any{ 0 };
+                            for (size_type w{ 0 }; w < Words; ++w) {
+                                const auto bits{ next[node][w] &
+                                                 ~seen[node][w] };
+                                next[node][w] = 0;
+                                visit[node][w] = bits;
+                                seen[node][w] |= bits;
+                                any |= bits;
+                                if (bits != 0) {
+                                    on_reach(base + w * 64, bits, node,
+                                             level);
+                                }
+                            }
+                            if (any != 0) { frontier.push_back(node); }
+                        }
+                    }
+                    on_finish(base, batch_sources.size(),
+                              std::as_const(seen));
+                }
+            },
+            1);
+    }
+}// namespace details
+
+// Result of a breadth-first search, indexed by node: the number of edges on
+// a shortest path from the source, and the node's parent in the
+// breadth-first tree. Both are npos for nodes the search didn't reach, and
+// the source is its own parent.
+struct bfs_result {
+    std::vector<std::size_t> distances;
+    std::vector<std::size_t> parents;
+};
+
+// Direction-optimizing breadth-first search (Beamer, Asanovic and
+// Patterson) from source, spread over pool. Levels with a small frontier
+// are expanded top-down, from the frontier along out-edges. Once the
+// frontier's out-edges outnumber those left to check, levels are expanded
+// bottom-up instead: every unreached node looks through its in-edges for a
+// parent in the frontier, and stops at the first one it finds. Visited
+// nodes and the bottom-up frontier are bitmaps.
+//
+// Which parent a node gets can depend on scheduling when several frontier
+// nodes reach it, but the distances never do.
+inline bfs_result
+breadth_first_search(const compressed_graph& graph, node_id source,
+                     thread_pool& pool = default_thread_pool());
+
+// As above, for a directed_graph or weighted_directed_graph, which is first
+// copied into a compressed_graph. When searching the same graph repeatedly,
+// make the copy once and search that.
+template<typename Graph>
+bfs_result breadth_first_search(const Graph& graph, node_id source,
+                                thread_pool& pool = default_thread_pool());
+
+inline bfs_result breadth_first_search(const compressed_graph& graph,
+                                       node_id source, thread_pool& pool) {
+    using size_type = std::size_t;
+    constexpr auto npos{ compressed_graph::npos };
+    // Switching thresholds, as tuned in the paper
+    constexpr size_type alpha{ 14 };
+    constexpr size_type beta{ 24 };
+
+    const auto n{ graph.size() };
+    bfs_result result{ std::vector<size_type>(n, npos),
+                       std::vector<size_type>(n, npos) };
+    if (source.index >= n) { return result; }
+    auto& distances{ result.distances };
+    auto& parents{ result.parents };
+
+    details::node_bitset visited{ n };
+    details::node_bitset frontier_bits{ n };
+    details::node_bitset next_bits{ n };
+    std::vector<size_type> frontier{ source.index };
+    visited.set(source.index);
+    distances[source.index] = 0;
+    parents[source.index] = source.index;
+
+    // Edges out of the frontier, and edges into unreached nodes, which are
+    // the work done by a top-down and a bottom-up step respectively
+    size_type frontier_edges{ graph.out_degree(source.index) };
+    size_type unexplored_edges{ graph.edge_count() -
+                                graph.in_degree(source.index) };
+
+    // Per-worker results, combined after each step
+    std::vector<std::vector<size_type>> next(pool.size());
+    std::vector<size_type> counts(pool.size());
+    std::vector<size_type> out_edge_counts(pool.size());
+    std::vector<size_type> in_edge_counts(pool.size());
+    auto reset_counts{ [&] {
+        std::fill(std::begin(counts), std::end(counts), 0);
+        std::fill(std::begin(out_edge_counts), std::end(out_edge_counts), 0);
+        std::fill(std::begin(in_edge_counts), std::end(in_edge_counts), 0);
+    } };
+    auto total{ [](const std::vector<size_type>& values) {
+        size_type sum{ 0 };
+        for (auto value: values) { sum += value; }
+        return sum;
+    } };
+
+    size_type level{ 0 };
+    while (!frontier.empty()) {
+        if (frontier_edges > unexplored_edges / alpha) {
+            frontier_bits.clear();
+            for (auto node: frontier) { frontier_bits.set(node); }
+            size_type frontier_size{ frontier.size() };
+            size_type previous_size{ 0 };
+            do {
+                // Bottom-up step. Each worker owns whole words of the
+                // bitmaps, so no atomics are needed.
+                reset_counts();
+                pool.parallel_for_chunks(
+                    0, visited.word_count(),
+                    [&](size_type worker, size_type first, size_type last) {
+                        for (auto w{ first }; w < last; ++w) {
+                            auto unreached{ ~visited.word(w) &
+                                            visited.valid_bits(w) };
+                            std::uint64_t found{ 0 };
+                            while (unreached != 0) {
+                                const auto bit{ std::countr_zero(unreached) };
+                                unreached &= unreached - 1;
+                                const auto node{ w * 64 + bit };
+                                for (auto parent: graph.in_edges(node)) {
+                                    if (!frontier_bits.test(parent)) {
+                                        continue;
+                                    }
+                                    parents[node] = parent;
+                                    distances[node] = level + 1;
+                                    found |= std::uint64_t{ 1 } << bit;
+                                    ++counts[worker];
+                                    out_edge_counts[worker] +=
+                                        graph.out_degree(node);
+                                    in_edge_counts[worker] +=
+                                        graph.in_degree(node);
+                                    break;
+                                }
+                            }
+                            visited.word(w) |= found;
+                            next_bits.word(w) = found;
+                        }
+                    },
+                    64);
+                ++level;
+                std::swap(frontier_bits, next_bits);
+                previous_size = frontier_size;
+                frontier_size = total(counts);
+                frontier_edges = total(out_edge_counts);
+                unexplored_edges -= total(in_edge_counts);
+            } while (frontier_size != 0 &&
+                     (frontier_size >= previous_size ||
+                      frontier_size > n / beta));
+
+            // Back to a list for the top-down steps
+            for (auto& nodes: next) { nodes.clear(); }
+            pool.parallel_for_chunks(
+                0, frontier_bits.word_count(),
+                [&](size_type worker, size_type first, size_type last) {
+                    for (auto w{ first }; w < last; ++w) {
+                        for (auto bits{ frontier_bits.word(w) }; bits != 0;
+                             bits &= bits - 1) {
+                            next[worker].push_back(w * 64 +
+                                                   std::countr_zero(bits));
+                        }
+                    }
+                },
+                64);
+        } else {
+            // Top-down step. Nodes are claimed by atomically setting their
+            // visited bit, so each gets exactly one parent.
+            reset_counts();
+            for (auto& nodes: next) { nodes.clear(); }
+            pool.parallel_for_chunks(
+                0, frontier.size(),
+                [&](size_type worker, size_type first, size_type last) {
+                    for (auto i{ first }; i < last; ++i) {
+                        const auto parent{ frontier[i] };
+                        for (auto node: graph.out_edges(parent)) {
+                            if (visited.atomic_test(node) ||
+                                !visited.atomic_set(node)) {
+                                continue;
+                            }
+                            parents[node] = parent;
+                            distances[node] = level + 1;
+                            next[worker].push_back(node);
+                            out_edge_counts[worker] += graph.out_degree(node);
+                            in_edge_counts[worker] += graph.in_degree(node);
+                        }
+                    }
+                },
+                64);
+            ++level;
+            frontier_edges = total(out_edge_counts);
+            unexplored_edges -= total(in_edge_counts);
+        }
+
+        frontier.clear();
+        for (auto& nodes: next) {
+            frontier.insert(std::end(frontier), std::begin(nodes),
+                            std::end(nodes));
+        }
+    }
+    return result;
+}
+
+template<typename Graph>
+bfs_result breadth_first_search(const Graph& graph, node_id source,
+                                thread_pool& pool) {
+    return breadth_first_search(compressed_graph{ graph, pool }, source,
+                                pool);
+}
+
+// Breadth-first searches from many sources at once (MS-BFS, Then et al.),
+// over a compressed_graph. Returns the number of edges on a shortest path
+// from each source to each node, at [source's position in sources][node],
+// or npos for nodes that source can't reach.
+//
+// Sources are taken in batches of up to 512, and each batch is searched
+// together, one bit per source in a mask per node, so that each level
+// scans a node's out-edges once for every search that reaches it at that
+// level rather than once per search. Masks are combined a 64-bit word at a
+// time. Batches are searched in parallel on pool, and are made smaller,
+// down to 64 sources, when that keeps more of its workers busy.
+inline std::vector<std::vector<std::size_t>>
+multi_source_bfs(const compressed_graph& graph,
+                 std::span<const std::size_t> sources,
+                 thread_pool& pool = default_thread_pool());
+
+// As above, but only finds which nodes each source can reach, which are set
+// at [source's position in sources][node]
+inline std::vector<std::vector<bool>>
+multi_source_reachability(const compressed_graph& graph,
+                          std::span<const std::size_t> sources,
+                          thread_pool& pool = default_thread_pool());
+
+// As above, for a directed_graph or weighted_directed_graph, which is first
+// copied into a compressed_graph
+template<typename Graph>
+std::vector<std::vector<std::size_t>>
+multi_source_bfs(const Graph& graph, std::span<const std::size_t> sources,
+                 thread_pool& pool = default_thread_pool());
+
+template<typename Graph>
+std::vector<std::vector<bool>>
+multi_source_reachability(const Graph& graph,
+                          std::span<const std::size_t> sources,
+                          thread_pool& pool = default_thread_pool());
+
+namespace details {
+    // Runs multi_source_bfs_batches with batches as wide as are worth it
+    // for the number of sources and workers
+    template<typename F, typename G>
+    void multi_source_bfs(const compressed_graph& graph,
+                          std::span<const std::size_t> sources,
+                          thread_pool& pool, F&& on_reach, G&& on_finish) {
+        const auto per_worker{ (sources.size() + pool.size() - 1) /
+                               pool.size() };
+        if (per_worker > 256) {
+            multi_source_bfs_batches<8>(graph, sources, pool, on_reach,
+                                          on_finish);
+        } else if (per_worker > 128) {
+            multi_source_bfs_batches<4>(graph, sources, pool, on_reach,
+                                          on_finish);
+        } else if (per_worker > 64) {
+            multi_source_bfs_batches<2>(graph, sources, pool, on_reach,
+                                          on_finish);
+        } else {
+            multi_source_bfs_batches<1>(graph, sources, pool, on_reach,
+                                          on_finish);
+        }
+    }
+}// namespace details
+
+inline std::vector<std::vector<std::size_t>>
+multi_source_bfs(const compressed_graph& graph,
+                 std::span<const std::size_t> sources, thread_pool& pool) {
+    std::vector<std::vector<std::size_t>> distances(
+        sources.size(),
+        std::vector<std::size_t>(graph.size(), compressed_graph::npos));
+    details::multi_source_bfs(
+        graph, sources, pool,
+        [&](std::size_t source, std::uint64_t bits, std::size_t node,
+            std::size_t level) {
+            for (; bits != 0; bits &= bits - 1) {
+                distances[source + std::countr_zero(bits)][node] = level;
+            }
+        },
+        [](std::size_t, std::size_t, const auto&) {});
+    return distances;
+}
+
+inline std::vector<std::vector<bool>>
+multi_source_reachability(const compressed_graph& graph,
+                          std::span<const std::size_t> sources,
+                          thread_pool& pool) {
+    std::vector<std::vector<bool>> reachable(
+        sources.size(), std::vector<bool>(graph.size(), false));
+    // Filled in from the masks at the end of each batch, one source at a
+    // time, rather than bit by bit as nodes are reached, which would touch
+    // a different source's vector with every bit
+    details::multi_source_bfs(
+        graph, sources, pool,
+        [](std::size_t, std::uint64_t, std::size_t, std::size_t) {},
+        [&](std::size_t first, std::size_t count, const auto& seen) {
+            for (std::size_t i{ 0 }; i < count; ++i) {
+                auto& row{ reachable[first + i] };
+                for (std::size_t node{ 0 }; node < row.size(); ++node) {
+                    row[node] = (seen[node][i / 64] >> (i % 64)) & 1;
+                }
+            }
+        });
+    return reachable;
+}
+
+template<typename Graph>
+std::vector<std::vector<std::size_t>>
+multi_source_bfs(const Graph& graph, std::span<const std::size_t> sources,
+                 thread_pool& pool) {
+    return multi_source_bfs(compressed_graph{ graph, pool }, sources, pool);
+}
+
+template<typename Graph>
+std::vector<std::vector<bool>>
+multi_source_reachability(const Graph& graph,
+                          std::span<const std::size_t> sources,
+                          thread_pool& pool) {
+    return multi_source_reachability(compressed_graph{ graph, pool }, sources,
+                                     pool);
+}
+
+// Iterative depth-first search from source, over a directed_graph,
+// weighted_directed_graph or compressed_graph, taking each node's out-edges
+// in order. The visitor may have any of the following members, which are
+// called as the search goes. Members it doesn't have cost nothing.
+//
+//   discover(u)               when u is first reached
+//   finish(u)                 when all of u's out-edges have been followed
+//   tree_edge(u, v)           just before v is first reached, through u -> v
+//   back_edge(u, v)           for an edge to a node still being explored,
+//                             which closes a cycle
+//   forward_or_cross_edge(u, v)  for an edge to a finished node
+//
+// Each may return void, or a bool that stops the search when false. Returns
+// false if the search was stopped. Nodes are tracked in bitsets and the
+// stack is allocated once, up front, so the search itself never allocates.
+template<typename Graph, typename Visitor>
+bool depth_first_search(const Graph& graph, node_id source, Visitor&& visitor);
+
+// As above, but searches from every node in index order that the earlier
+// searches didn't reach, so that every node and edge is visited
+template<typename Graph, typename Visitor>
+bool depth_first_search(const Graph& graph, Visitor&& visitor);
+
+// Returns true if the graph has a directed cycle
+template<typename Graph>
+[[nodiscard]] bool has_cycle(const Graph& graph);
+
+template<typename Graph, typename Visitor>
+bool depth_first_search(const Graph& graph, node_id source, Visitor&& visitor) {
+    if (source.index >= graph.size()) { return true; }
+    details::dfs_state state{ graph };
+    return state.run(source.index, visitor);
+}
+
+template<typename Graph, typename Visitor>
+bool depth_first_search(const Graph& graph, Visitor&& visitor) {
+    details::dfs_state state{ graph };
+    for (std::size_t root{ 0 }; root < graph.size(); ++root) {
+        if (!state.discovered(root) && !state.run(root, visitor)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename Graph>
+bool has_cycle(const Graph& graph) {
+    struct cycle_finder {
+        bool back_edge(std::size_t, std::size_t) { return false; }
+    };
+    // The only way for the search to stop is on a back edge
+    return !depth_first_search(graph, cycle_finder{});
+}
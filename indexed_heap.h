@@ -0,0 +1,215 @@
+//
+// A d-ary min-heap of node indices that supports decrease-key.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A min-heap of items in [0, capacity()), such as node indices, each with a
+// key. Every item's position in the heap is kept in a flat array, so an
+// item's key can be lowered in place instead of pushing it a second time,
+// and the heap never holds more than one entry per item. Each entry has
+// Arity children rather than two, which makes the heap shallower and keeps
+// the children compared by pop() next to each other in memory.
+template<typename Key = double, std::size_t Arity = 4>
+class indexed_heap {
+    static_assert(Arity >= 2, "a heap needs at least two children per entry");
+
+public:
+    using size_type = std::size_t;
+    using key_type = Key;
+
+    explicit indexed_heap(size_type capacity = 0);
+
+    // Makes room for items in [0, capacity). The heap must be empty.
+    void resize(size_type capacity);
+
+    [[nodiscard]] size_type capacity() const noexcept;
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    [[nodiscard]] bool contains(size_type item) const;
+
+    // The key of an item in the heap
+    [[nodiscard]] const key_type& key(size_type item) const;
+
+    // Adds an item that is not in the heap
+    void push(size_type item, key_type key);
+
+    // Lowers the key of an item in the heap. key must not be greater than
+    // its current key.
+    void decrease_key(size_type item, key_type key);
+
+    // Adds item, or lowers its key if it is in the heap with a greater one.
+    // Returns false if the heap was left unchanged.
+    bool push_or_decrease(size_type item, key_type key);
+
+    // The item with the smallest key, and that key. The heap must not be
+    // empty.
+    [[nodiscard]] size_type top() const;
+
+    [[nodiscard]] const key_type& top_key() const;
+
+    // Removes the item with the smallest key
+    void pop();
+
+    // Removes all items, in time proportional to size() rather than to
+    // capacity(), so a large heap can be reused cheaply
+    void clear() noexcept;
+
+private:
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    struct entry {
+        key_type key;
+        size_type item;
+    };
+
+    std::vector<entry> m_entries;
+    // Position of each item in m_entries, or npos if it isn't in the heap
+    std::vector<size_type> m_positions;
+
+    void sift_up(size_type position);
+
+    void sift_down(size_type position);
+
+    void place(size_type position, entry&& value);
+};
+
+template<typename Key, std::size_t Arity>
+indexed_heap<Key, Arity>::indexed_heap(size_type capacity)
+    : m_positions(capacity, npos) {}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::resize(size_type capacity) {
+    m_positions.resize(capacity, npos);
+}
+
+template<typename Key, std::size_t Arity>
+typename indexed_heap<Key, Arity>::size_type
+indexed_heap<Key, Arity>::capacity() const noexcept {
+    return m_positions.size();
+}
+
+template<typename Key, std::size_t Arity>
+typename indexed_heap<Key, Arity>::size_type
+indexed_heap<Key, Arity>::size() const noexcept {
+    return m_entries.size();
+}
+
+template<typename Key, std::size_t Arity>
+bool indexed_heap<Key, Arity>::empty() const noexcept {
+    return m_entries.empty();
+}
+
+template<typename Key, std::size_t Arity>
+bool indexed_heap<Key, Arity>::contains(size_type item) const {
+    return m_positions[item] != npos;
+}
+
+template<typename Key, std::size_t Arity>
+const typename indexed_heap<Key, Arity>::key_type&
+indexed_heap<Key, Arity>::key(size_type item) const {
+    return m_entries[m_positions[item]].key;
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::push(size_type item, key_type key) {
+    m_positions[item] = m_entries.size();
+    m_entries.push_back({ std::move(key), item });
+    sift_up(m_entries.size() - 1);
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::decrease_key(size_type item, key_type key) {
+    const auto position{ m_positions[item] };
+    m_entries[position].key = std::move(key);
+    sift_up(position);
+}
+
+template<typename Key, std::size_t Arity>
+bool indexed_heap<Key, Arity>::push_or_decrease(size_type item,
+                                                key_type key) {
+    if (!contains(item)) {
+        push(item, std::move(key));
+        return true;
+    }
+    if (!(key < this->key(item))) { return false; }
+    decrease_key(item, std::move(key));
+    return true;
+}
+
+template<typename Key, std::size_t Arity>
+typename indexed_heap<Key, Arity>::size_type
+indexed_heap<Key, Arity>::top() const {
+    return m_entries.front().item;
+}
+
+template<typename Key, std::size_t Arity>
+const typename indexed_heap<Key, Arity>::key_type&
+indexed_heap<Key, Arity>::top_key() const {
+    return m_entries.front().key;
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::pop() {
+    m_positions[m_entries.front().item] = npos;
+    auto last{ std::move(m_entries.back()) };
+    m_entries.pop_back();
+    if (!m_entries.empty()) {
+        place(0, std::move(last));
+        sift_down(0);
+    }
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::clear() noexcept {
+    for (const auto& value: m_entries) { m_positions[value.item] = npos; }
+    m_entries.clear();
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::place(size_type position, entry&& value) {
+    m_positions[value.item] = position;
+    m_entries[position] = std::move(value);
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::sift_up(size_type position) {
+    // Move parents down into the hole until the entry fits, rather than
+    // swapping at every level
+    auto value{ std::move(m_entries[position]) };
+    while (position > 0) {
+        const auto parent{ (position - 1) / Arity };
+        if (!(value.key < m_entries[parent].key)) { break; }
+        place(position, std::move(m_entries[parent]));
+        position = parent;
+    }
+    place(position, std::move(value));
+}
+
+template<typename Key, std::size_t Arity>
+void indexed_heap<Key, Arity>::sift_down(size_type position) {
+    const auto count{ m_entries.size() };
+    auto value{ std::move(m_entries[position]) };
+    while (true) {
+        const auto first_child{ position * Arity + 1 };
+        if (first_child >= count) { break; }
+        const auto last_child{ std::min(first_child + Arity, count) };
+        auto smallest{ first_child };
+        for (auto child{ first_child + 1 }; child < last_child; ++child) {
+            if (m_entries[child].key < m_entries[smallest].key) {
+                smallest = child;
+            }
+        }
+        if (!(m_entries[smallest].key < value.key)) { break; }
+        place(position, std::move(m_entries[smallest]));
+        position = smallest;
+    }
+    place(position, std::move(value));
+}
@@ -0,0 +1,425 @@
+//
+// Landmark distance tables, for A* lower bounds by the triangle inequality.
+//
+#pragma once
+
+#include "graph_common.h"
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace details {
+    // Runs Dijkstra from source until every node it can reach is settled,
+    // following in-edges rather than out-edges if Reverse, and calls
+    // on_settle(node) for each node in the order they are settled
+    template<bool Reverse, typename Graph, typename F>
+    void settle_all(const Graph& graph, std::size_t source,
+                    dijkstra_state& state, F&& on_settle) {
+        state.reset(graph.size());
+        state.relax(source, 0, source);
+        while (!state.heap.empty()) {
+            const auto node{ state.heap.top() };
+            const auto distance{ state.heap.top_key() };
+            state.heap.pop();
+            on_settle(node);
+            for_each_weighted_edge<Reverse>(
+                graph, node, [&](std::size_t next, double weight) {
+                    state.relax(next, distance + weight, node);
+                });
+        }
+    }
+}// namespace details
+
+class alt_heuristic;
+
+// Distances between a few landmark nodes and every node of a graph, for
+// the ALT (A*, landmarks and triangle inequality) lower bounds of Goldberg
+// and Harrelson. If d(L, x) and d(x, L) are the distances from and to a
+// landmark L, then for any nodes v and t
+//
+//   d(v, t) >= d(L, t) - d(L, v)   and   d(v, t) >= d(v, L) - d(t, L)
+//
+// and the best of these over all landmarks is an A* heuristic that never
+// overestimates and never drops by more than an edge's weight. Landmarks
+// are chosen, one after another, either as the node farthest from those
+// already chosen, or by the "avoid" method of Goldberg and Werneck, which
+// picks a landmark behind the part of a shortest path tree whose bounds
+// are currently worst.
+//
+// The distances are stored as floats, interleaved so that all of a node's
+// landmark distances sit together and a bound reads two short runs of
+// memory. Bounds allow for the floats' rounding, so they remain lower
+// bounds. Tables can be saved and loaded, so that they are computed once
+// and shared.
+class alt_landmarks {
+public:
+    using size_type = std::size_t;
+
+    enum class selection { farthest, avoid };
+
+    alt_landmarks() = default;
+
+    // Chooses up to count landmarks in graph, a weighted_directed_graph or
+    // a compressed_graph, and finds their distances. The two searches from
+    // each landmark run in parallel on pool. Edge weights must not be
+    // negative.
+    template<typename Graph>
+    alt_landmarks(const Graph& graph, size_type count,
+                  selection strategy = selection::avoid,
+                  thread_pool& pool = default_thread_pool());
+
+    // Number of nodes in the graph the tables were made for
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] std::span<const size_type> landmarks() const noexcept;
+
+    // A lower bound on the distance from `from` to `to`, which is infinity
+    // if the landmarks show that there is no path
+    [[nodiscard]] double lower_bound(size_type from, size_type to) const;
+
+    // A heuristic for astar_search, for queries to target. It refers to
+    // this object, which must outlive it.
+    [[nodiscard]] alt_heuristic heuristic(node_id target) const;
+
+    // Writes the tables in a binary format, in the machine's byte order.
+    // Returns false if the stream failed.
+    bool save(std::ostream& out) const;
+
+    // Reads tables written by save(), or returns nothing if the stream
+    // doesn't hold any. Counts that are larger than the stream's data, and
+    // landmarks that aren't nodes, are rejected rather than trusted.
+    [[nodiscard]] static std::optional<alt_landmarks> load(std::istream& in);
+
+private:
+    static constexpr std::array<char, 4> file_magic{ 'A', 'L', 'T', '1' };
+
+    size_type m_nodeCount{ 0 };
+    std::vector<size_type> m_landmarks;
+    // Distances from each landmark to each node, and from each node to each
+    // landmark, at [node * landmark count + landmark]
+    std::vector<float> m_fromLandmarks;
+    std::vector<float> m_toLandmarks;
+
+    // Index of the landmark to add next, chosen by the avoid method from a
+    // shortest path tree rooted at root
+    template<typename Graph>
+    [[nodiscard]] size_type avoid_landmark(const Graph& graph, size_type root,
+                                           details::dijkstra_state& state);
+};
+
+// A* heuristic from alt_landmarks: the lower bound on the distance from a
+// node to a fixed target
+class alt_heuristic {
+public:
+    [[nodiscard]] double operator()(std::size_t node) const;
+
+private:
+    friend class alt_landmarks;
+
+    alt_heuristic(const alt_landmarks& landmarks, std::size_t target);
+
+    const alt_landmarks* m_landmarks;
+    std::size_t m_target;
+};
+
+template<typename Graph>
+alt_landmarks::alt_landmarks(const Graph& graph, size_type count,
+                             selection strategy, thread_pool& pool)
+    : m_nodeCount{ graph.size() } {
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    const auto n{ m_nodeCount };
+    count = std::min(count, n);
+    m_landmarks.reserve(count);
+    m_fromLandmarks.assign(n * count, 0);
+    m_toLandmarks.assign(n * count, 0);
+    if (count == 0) { return; }
+
+    // Forward and backward search states, and for the farthest method, the
+    // distance from the nearest landmark so far to each node. It starts
+    // out as the distance from node 0, so that the first landmark is the
+    // node farthest from there.
+    std::array<details::dijkstra_state, 2> states;
+    std::vector<double> nearest;
+    if (strategy == selection::farthest) {
+        details::settle_all<false>(graph, 0, states[0], [](size_type) {});
+        nearest = states[0].distances;
+    }
+
+    for (size_type i{ 0 }; i < count; ++i) {
+        auto landmark{ details::dijkstra_state::npos };
+        if (strategy == selection::farthest) {
+            // Nodes no landmark reaches count as the farthest of all
+            auto farthest{ -infinity };
+            for (size_type node{ 0 }; node < n; ++node) {
+                if (nearest[node] > farthest) {
+                    farthest = nearest[node];
+                    landmark = node;
+                }
+            }
+        } else {
+            // Trees are rooted at scattered nodes, and roots already chosen
+            // as landmarks are skipped
+            auto root{ static_cast<size_type>(details::mix_hash(i) % n) };
+            while (std::find(std::begin(m_landmarks), std::end(m_landmarks),
+                             root) != std::end(m_landmarks)) {
+                root = (root + 1) % n;
+            }
+            landmark = avoid_landmark(graph, root, states[0]);
+        }
+        m_landmarks.push_back(landmark);
+
+        pool.parallel_for(
+            0, 2,
+            [&](size_type direction) {
+                if (direction == 0) {
+                    details::settle_all<false>(graph, landmark, states[0],
+                                               [](size_type) {});
+                } else {
+                    details::settle_all<true>(graph, landmark, states[1],
+                                              [](size_type) {});
+                }
+            },
+            1);
+        for (size_type node{ 0 }; node < n; ++node) {
+            m_fromLandmarks[node * count + i] =
+                static_cast<float>(states[0].distances[node]);
+            m_toLandmarks[node * count + i] =
+                static_cast<float>(states[1].distances[node]);
+        }
+        if (strategy == selection::farthest) {
+            for (size_type node{ 0 }; node < n; ++node) {
+                nearest[node] =
+                    std::min(nearest[node], states[0].distances[node]);
+            }
+            nearest[landmark] = -infinity;
+        }
+    }
+}
+
+template<typename Graph>
+alt_landmarks::size_type
+alt_landmarks::avoid_landmark(const Graph& graph, size_type root,
+                              details::dijkstra_state& state) {
+    constexpr auto npos{ details::dijkstra_state::npos };
+    const auto n{ graph.size() };
+    std::vector<size_type> order;
+    details::settle_all<false>(graph, root, state,
+                               [&order](size_type node) {
+                                   order.push_back(node);
+                               });
+    const auto& parents{ state.parents };
+
+    // Each node's weight is how far the current bounds fall short of its
+    // distance from the root. A subtree's size is the total weight in it,
+    // or zero if it holds a landmark, since that part is covered already.
+    std::vector<double> sizes(n, 0);
+    std::vector<char> covered(n, 0);
+    for (auto landmark: m_landmarks) { covered[landmark] = 1; }
+    for (auto iter{ std::rbegin(order) }; iter != std::rend(order); ++iter) {
+        const auto node{ *iter };
+        const auto bound{ m_landmarks.empty() ? 0 : lower_bound(root, node) };
+        sizes[node] += state.distances[node] -
+                       std::min(bound, state.distances[node]);
+        if (node == root) { continue; }
+        if (covered[node]) {
+            covered[parents[node]] = 1;
+        } else {
+            sizes[parents[node]] += sizes[node];
+        }
+    }
+
+    // Follow the largest uncovered subtree from the root down to a leaf
+    std::vector<size_type> child_offsets(n + 1, 0);
+    for (auto node: order) {
+        if (node != root) { ++child_offsets[parents[node] + 1]; }
+    }
+    for (size_type node{ 0 }; node < n; ++node) {
+        child_offsets[node + 1] += child_offsets[node];
+    }
+    std::vector<size_type> children(child_offsets[n]);
+    auto cursors{ child_offsets };
+    for (auto node: order) {
+        if (node != root) { children[cursors[parents[node]]++] = node; }
+    }
+    auto node{ root };
+    while (true) {
+        auto next{ npos };
+        for (auto i{ child_offsets[node] }; i < child_offsets[node + 1];
+             ++i) {
+            const auto child{ children[i] };
+            if (covered[child]) { continue; }
+            if (next == npos || sizes[child] > sizes[next]) { next = child; }
+        }
+        if (next == npos) { break; }
+        node = next;
+    }
+    if (covered[node]) {
+        // Everything reachable from the root is covered, so use the first
+        // node that isn't a landmark yet
+        std::vector<char> landmarks(n, 0);
+        for (auto landmark: m_landmarks) { landmarks[landmark] = 1; }
+        node = static_cast<size_type>(
+            std::find(std::begin(landmarks), std::end(landmarks), 0) -
+            std::begin(landmarks));
+    }
+    return node;
+}
+
+inline alt_landmarks::size_type alt_landmarks::size() const noexcept {
+    return m_nodeCount;
+}
+
+inline std::span<const alt_landmarks::size_type>
+alt_landmarks::landmarks() const noexcept {
+    return m_landmarks;
+}
+
+inline double alt_landmarks::lower_bound(size_type from, size_type to) const {
+    constexpr double epsilon{ std::numeric_limits<float>::epsilon() };
+    const auto count{ m_landmarks.size() };
+    const auto* from_landmark{ m_fromLandmarks.data() + from * count };
+    const auto* to_landmark{ m_fromLandmarks.data() + to * count };
+    const auto* from_to{ m_toLandmarks.data() + from * count };
+    const auto* to_to{ m_toLandmarks.data() + to * count };
+    double bound{ 0 };
+    for (size_type i{ 0 }; i < count; ++i) {
+        // Each stored distance may be off by half a float's precision, so
+        // take that much more off each difference
+        if (std::isfinite(from_landmark[i])) {
+            // The landmark reaches `from` but not `to`, so `from` can't
+            // reach `to` either
+            if (!std::isfinite(to_landmark[i])) {
+                return std::numeric_limits<double>::infinity();
+            }
+            const double a{ to_landmark[i] };
+            const double b{ from_landmark[i] };
+            bound = std::max(bound, a - b - (a + b) * epsilon);
+        }
+        if (std::isfinite(to_to[i])) {
+            if (!std::isfinite(from_to[i])) {
+                return std::numeric_limits<double>::infinity();
+            }
+            const double a{ from_to[i] };
+            const double b{ to_to[i] };
+            bound = std::max(bound, a - b - (a + b) * epsilon);
+        }
+    }
+    return bound;
+}
+
+inline alt_heuristic alt_landmarks::heuristic(node_id target) const {
+    return { *this, target.index };
+}
+
+inline bool alt_landmarks::save(std::ostream& out) const {
+    const auto write{ [&out](const auto* data, std::size_t count) {
+        out.write(reinterpret_cast<const char*>(data),
+                  static_cast<std::streamsize>(count * sizeof(*data)));
+    } };
+    const std::uint64_t node_count{ m_nodeCount };
+    const std::uint64_t landmark_count{ m_landmarks.size() };
+    const std::vector<std::uint64_t> landmarks(std::begin(m_landmarks),
+                                               std::end(m_landmarks));
+    write(file_magic.data(), file_magic.size());
+    write(&node_count, 1);
+    write(&landmark_count, 1);
+    write(landmarks.data(), landmarks.size());
+    write(m_fromLandmarks.data(), m_fromLandmarks.size());
+    write(m_toLandmarks.data(), m_toLandmarks.size());
+    return static_cast<bool>(out);
+}
+
+inline std::optional<alt_landmarks> alt_landmarks::load(std::istream& in) {
+    const auto read{ [&in](auto* data, std::size_t count) {
+        in.read(reinterpret_cast<char*>(data),
+                static_cast<std::streamsize>(count * sizeof(*data)));
+        return static_cast<bool>(in);
+    } };
+    // Reads count values onto the end of values in bounded chunks, so that
+    // a count larger than the stream holds runs out of data before it can
+    // allocate much more than the stream did hold
+    const auto read_values{ [&read](auto& values, std::uint64_t count) {
+        constexpr std::uint64_t chunk{ 1 << 16 };
+        while (count != 0) {
+            const auto size{ values.size() };
+            const auto step{ std::min(count, chunk) };
+            values.resize(size + step);
+            if (!read(values.data() + size, step)) { return false; }
+            count -= step;
+        }
+        return true;
+    } };
+    std::array<char, 4> magic{};
+    std::uint64_t node_count{ 0 };
+    std::uint64_t landmark_count{ 0 };
+    if (!read(magic.data(), magic.size()) || magic != file_magic ||
+        !read(&node_count, 1) || !read(&landmark_count, 1) ||
+        landmark_count > node_count) {
+        return {};
+    }
+
+    // The landmark list and the two tables take at most entry_bytes per
+    // table entry, as there are no more landmarks than entries. Counts whose
+    // size doesn't fit in the address space can't have been written by save().
+    using distance_type = decltype(m_fromLandmarks)::value_type;
+    constexpr std::uint64_t entry_bytes{ sizeof(std::uint64_t) +
+                                         2 * sizeof(distance_type) };
+    constexpr std::uint64_t max_entries{
+        std::numeric_limits<std::size_t>::max() / entry_bytes };
+    if (landmark_count != 0 && node_count > max_entries / landmark_count) {
+        return {};
+    }
+    const auto entries{ node_count * landmark_count };
+
+    // Where the stream can tell, reject counts that need more data than is
+    // left in it up front
+    const auto start{ in.tellg() };
+    if (start != std::istream::pos_type(-1)) {
+        in.seekg(0, std::ios::end);
+        const auto end{ in.tellg() };
+        in.seekg(start);
+        const auto needed{ landmark_count * sizeof(std::uint64_t) +
+                           2 * entries * sizeof(distance_type) };
+        if (!in || end < start ||
+            static_cast<std::uint64_t>(end - start) < needed) {
+            return {};
+        }
+    }
+
+    alt_landmarks result;
+    result.m_nodeCount = node_count;
+    std::vector<std::uint64_t> landmarks;
+    if (!read_values(landmarks, landmark_count) ||
+        !read_values(result.m_fromLandmarks, entries) ||
+        !read_values(result.m_toLandmarks, entries)) {
+        return {};
+    }
+    if (std::any_of(std::begin(landmarks), std::end(landmarks),
+                    [node_count](std::uint64_t landmark) {
+                        return landmark >= node_count;
+                    })) {
+        return {};
+    }
+    result.m_landmarks.assign(std::begin(landmarks), std::end(landmarks));
+    return result;
+}
+
+inline alt_heuristic::alt_heuristic(const alt_landmarks& landmarks,
+                                    std::size_t target)
+    : m_landmarks{ &landmarks }, m_target{ target } {}
+
+inline double alt_heuristic::operator()(std::size_t node) const {
+    return m_landmarks->lower_bound(node, m_target);
+}
@@ -1,9 +1,9 @@
 #include "directed_graph.h"
+#include "shortest_paths.h"
 #include "weighted_directed_graph.h"
+#include <algorithm>
 #include <iostream>
 #include <map>
-#include <queue>
-#include <set>
 #include <vector>
 
 struct Point {
@@ -17,23 +17,30 @@ struct Point {
 
 template<typename T, typename A>
 void dfs(const weighted_directed_graph<T, A>& graph, const T& start_node) {
-    std::stack<T> stack;
-    std::set<T> visited;
+    using graph_type = weighted_directed_graph<T, A>;
+    const auto start{ graph.index_of(start_node) };
+    if (start == graph_type::npos) { return; }
 
-    stack.push(start_node);
-    visited.insert(start_node);
+    // Walk node indices rather than values. Each node is marked when it is
+    // pushed, so the stack never holds more than one entry per node.
+    std::vector<char> visited(graph.size(), 0);
+    std::vector<size_t> stack;
+    stack.reserve(graph.size());
+
+    stack.push_back(start);
+    visited[start] = 1;
 
     while (!stack.empty()) {
-        T current_node = stack.top();
-        stack.pop();
-        // Process current_node here
-        std::cout << "DFS:" << current_node << '\n';
-
-        for (const auto& neighbor:
-             graph.get_adjacent_nodes_values(current_node)) {
-            if (visited.find(neighbor) == visited.end()) {
-                stack.push(neighbor);
-                visited.insert(neighbor);
+        const auto current{ stack.back() };
+        stack.pop_back();
+        // Process current here
+        std::cout << "DFS:" << graph.value(current) << '\n';
+
+        for (auto&& edge: graph.out_edges(current)) {
+            const auto neighbor{ edge.index() };
+            if (!visited[neighbor]) {
+                stack.push_back(neighbor);
+                visited[neighbor] = 1;
             }
         }
     }
@@ -41,23 +48,29 @@ void dfs(const weighted_directed_graph<T, A>& graph, const T& start_node) {
 
 template<typename T, typename A>
 void bfs(const weighted_directed_graph<T, A>& graph, const T& start_node) {
-    std::queue<T> queue;
-    std::set<T> visited;
-
-    queue.push(start_node);
-    visited.insert(start_node);
-
-    while (!queue.empty()) {
-        T current_node = queue.front();
-        queue.pop();
-        // Process current_node here
-        std::cout << "BFS:" << current_node << '\n';
-
-        for (const auto& neighbor:
-             graph.get_adjacent_nodes_values(current_node)) {
-            if (visited.find(neighbor) == visited.end()) {
-                queue.push(neighbor);
-                visited.insert(neighbor);
+    using graph_type = weighted_directed_graph<T, A>;
+    const auto start{ graph.index_of(start_node) };
+    if (start == graph_type::npos) { return; }
+
+    // Every node is queued at most once, so a vector sized up front serves
+    // as the queue, with head marking the next node to process
+    std::vector<char> visited(graph.size(), 0);
+    std::vector<size_t> queue;
+    queue.reserve(graph.size());
+
+    queue.push_back(start);
+    visited[start] = 1;
+
+    for (size_t head{ 0 }; head < queue.size(); ++head) {
+        const auto current{ queue[head] };
+        // Process current here
+        std::cout << "BFS:" << graph.value(current) << '\n';
+
+        for (auto&& edge: graph.out_edges(current)) {
+            const auto neighbor{ edge.index() };
+            if (!visited[neighbor]) {
+                queue.push_back(neighbor);
+                visited[neighbor] = 1;
             }
         }
     }
@@ -66,98 +79,54 @@ void bfs(const weighted_directed_graph<T, A>& graph, const T& start_node) {
 template<typename T, typename A>
 std::map<T, double> dijkstra(const weighted_directed_graph<T, A>& graph,
                              const T& start_node) {
-    std::priority_queue<std::pair<double, T>, std::vector<std::pair<double, T>>,
-                        std::greater<>>
-        pq;
-    std::map<T, double> distances;
-    std::set<T> visited;
-
-    pq.push({ 0, start_node });
-    distances[start_node] = 0;
-
-    while (!pq.empty()) {
-        double dist = pq.top().first;
-        T current_node = pq.top().second;
-        pq.pop();
-
-        if (visited.find(current_node) != visited.end()) { continue; }
-        visited.insert(current_node);
-
-        std::cout << "IJK:" << current_node << '\n';
-
-        for (const auto& [neighbor_node, edge_weight]:
-             graph.get_adjacent_nodes_values_and_weights(current_node)) {
-            double new_dist = dist + edge_weight;
-            if (distances.find(neighbor_node) == distances.end() ||
-                new_dist < distances[neighbor_node]) {
-                distances[neighbor_node] = new_dist;
-                pq.push({ new_dist, neighbor_node });
-            }
-        }
+    using graph_type = weighted_directed_graph<T, A>;
+    std::map<T, double> result;
+    const auto start{ graph.index_of(start_node) };
+    if (start == graph_type::npos) { return result; }
+
+    // Search on node indices, and only translate back to values once the
+    // search is finished
+    dijkstra_search search;
+    search.run(graph, node_id{ start });
+    std::vector<size_t> reached;
+    for (size_t i{ 0 }; i < graph.size(); ++i) {
+        if (search.reached(i)) { reached.push_back(i); }
     }
 
-    return distances;
+    // Report the nodes in the order the search settled them: by distance,
+    // with ties going to the smaller value
+    std::ranges::sort(reached, [&](size_t lhs, size_t rhs) {
+        return std::pair{ search.distance(lhs), graph.value(lhs) } <
+               std::pair{ search.distance(rhs), graph.value(rhs) };
+    });
+    for (auto i: reached) {
+        std::cout << "IJK:" << graph.value(i) << '\n';
+        result.emplace(graph.value(i), search.distance(i));
+    }
+    return result;
 }
 
 template<typename T, typename A>
 std::vector<T> dijkstra(const weighted_directed_graph<T, A>& graph,
                         const T& start_node, const T& end_node) {
-    if (std::find(std::begin(graph), std::end(graph), start_node) ==
-        std::end(graph)) {
+    using graph_type = weighted_directed_graph<T, A>;
+    const auto start{ graph.index_of(start_node) };
+    if (start == graph_type::npos) {
         std::cerr << "Start node [" << start_node << "] is not in this graph";
         return std::vector<T>{};
     }
 
-    if (std::find(std::begin(graph), std::end(graph), end_node) ==
-        std::end(graph)) {
+    const auto end{ graph.index_of(end_node) };
+    if (end == graph_type::npos) {
         std::cerr << "End node [" << end_node << "] is not in this graph";
         return std::vector<T>{};
     }
 
-    std::priority_queue<std::pair<double, T>, std::vector<std::pair<double, T>>,
-                        std::greater<>>
-        pq;
-    std::map<T, double> distances;
-    std::map<T, T>
-        previous;// Map to store the previous node in the shortest path.
-    std::set<T> visited;
-
-    pq.push({ 0, start_node });
-    distances[start_node] = 0;
-
-    while (!pq.empty()) {
-        double dist = pq.top().first;
-        T current_node = pq.top().second;
-        pq.pop();
-
-        if (visited.find(current_node) != visited.end()) { continue; }
-        visited.insert(current_node);
-
-        if (current_node == end_node) { break; }
-
-        for (const auto& [neighbor_node, edge_weight]:
-             graph.get_adjacent_nodes_values_and_weights(current_node)) {
-            double new_dist = dist + edge_weight;
-            if (distances.find(neighbor_node) == distances.end() ||
-                new_dist < distances[neighbor_node]) {
-                distances[neighbor_node] = new_dist;
-                previous[neighbor_node] = current_node;
-                pq.push({ new_dist, neighbor_node });
-            }
-        }
-    }
+    dijkstra_search search;
+    search.run(graph, node_id{ start }, node_id{ end });
 
-    // Reconstruct the path
     std::vector<T> path;
-    T current = end_node;
-    while (current != start_node) {
-        path.push_back(current);
-        current = previous[current];
-    }
-    path.push_back(
-        start_node);// Final step - complete the path with the start node
-    std::reverse(path.begin(), path.end());
-
+    for (auto index: search.path(end)) { path.push_back(graph.value(index)); }
     return path;
 }
 
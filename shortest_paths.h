@@ -0,0 +1,772 @@
+//
+// Single-source shortest paths over node indices.
+//
+#pragma once
+
+#include "compressed_graph.h"
+#include "graph_common.h"
+#include "graph_traversal.h"
+#include "indexed_heap.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace details {
+    // Calls fn(to, weight) for each edge out of node, for a
+    // weighted_directed_graph, a directed_graph or a compressed_graph.
+    // Edges of unweighted graphs have weight 1. With Reverse, calls
+    // fn(from, weight) for each edge into node instead, which directed_graph
+    // doesn't support. A weighted_directed_graph only lists the sources of
+    // its in-edges, so their weights are looked up in the sources'
+    // out-edges.
+    template<bool Reverse = false, typename Graph, typename F>
+    void for_each_weighted_edge(const Graph& graph, std::size_t node, F&& fn) {
+        if constexpr (std::is_same_v<Graph, compressed_graph>) {
+            const auto ends{ Reverse ? graph.in_edges(node)
+                                     : graph.out_edges(node) };
+            const auto weights{ Reverse ? graph.in_weights(node)
+                                        : graph.out_weights(node) };
+            for (std::size_t i{ 0 }; i < ends.size(); ++i) {
+                fn(ends[i], weights.empty() ? 1.0 : weights[i]);
+            }
+        } else if constexpr (Reverse) {
+            for (auto from: graph.in_edges(node)) {
+                fn(from, *graph.edge_weight(node_id{ from }, node_id{ node }));
+            }
+        } else {
+            for (auto&& edge: graph.out_edges(node)) {
+                if constexpr (weighted_edge<std::remove_cvref_t<decltype(
+                                  edge)>>) {
+                    fn(edge_target(edge), static_cast<double>(edge.weight()));
+                } else {
+                    fn(edge_target(edge), 1.0);
+                }
+            }
+        }
+    }
+
+    // A graph's weighted out-edges in compressed sparse row form
+    struct weighted_edge_rows {
+        std::vector<std::size_t> offsets;
+        std::vector<std::size_t> targets;
+        std::vector<double> weights;
+    };
+
+    // Lowers distance to candidate if that is smaller, while other threads
+    // may be doing the same. Returns true if this call lowered it.
+    inline bool atomic_lower(double& distance, double candidate) {
+        std::atomic_ref value{ distance };
+        auto current{ value.load(std::memory_order_relaxed) };
+        while (candidate < current) {
+            if (value.compare_exchange_weak(current, candidate,
+                                            std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Distances, parents and the heap of one Dijkstra search, all indexed
+    // by node. They are kept from one search to the next, and reset() only
+    // clears the entries the last search touched.
+    struct dijkstra_state {
+        static constexpr std::size_t npos{ static_cast<std::size_t>(-1) };
+
+        std::vector<double> distances;
+        std::vector<std::size_t> parents;
+        // Nodes whose entries have been set, for reset() to clear
+        std::vector<std::size_t> touched;
+        indexed_heap<double> heap;
+
+        // Readies the state for a search over node_count nodes
+        void reset(std::size_t node_count);
+
+        [[nodiscard]] bool reached(std::size_t node) const;
+
+        // Lowers the distance of node to distance, through parent, if that
+        // is shorter, and queues it by that distance. Returns false if it
+        // isn't shorter.
+        bool relax(std::size_t node, double distance, std::size_t parent);
+
+        // As above, but queues node by priority rather than by distance
+        bool relax(std::size_t node, double distance, std::size_t parent,
+                   double priority);
+
+        // Appends the nodes on the path from node back to the search's
+        // source, which is its own parent
+        void append_path(std::size_t node,
+                         std::vector<std::size_t>& nodes) const;
+    };
+
+    inline void dijkstra_state::reset(std::size_t node_count) {
+        constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+        if (distances.size() != node_count) {
+            distances.assign(node_count, infinity);
+            parents.assign(node_count, npos);
+            heap.clear();
+            heap.resize(node_count);
+        } else {
+            for (auto node: touched) {
+                distances[node] = infinity;
+                parents[node] = npos;
+            }
+            heap.clear();
+        }
+        touched.clear();
+    }
+
+    inline bool dijkstra_state::reached(std::size_t node) const {
+        return parents[node] != npos;
+    }
+
+    inline bool dijkstra_state::relax(std::size_t node, double distance,
+                                      std::size_t parent) {
+        return relax(node, distance, parent, distance);
+    }
+
+    inline bool dijkstra_state::relax(std::size_t node, double distance,
+                                      std::size_t parent, double priority) {
+        if (!(distance < distances[node])) { return false; }
+        if (parents[node] == npos) { touched.push_back(node); }
+        distances[node] = distance;
+        parents[node] = parent;
+        heap.push_or_decrease(node, priority);
+        return true;
+    }
+
+    inline void
+    dijkstra_state::append_path(std::size_t node,
+                                std::vector<std::size_t>& nodes) const {
+        for (; parents[node] != node; node = parents[node]) {
+            nodes.push_back(node);
+        }
+        nodes.push_back(node);
+    }
+}// namespace details
+
+// Result of a single-source shortest path search, indexed by node: the
+// total weight of a shortest path from the source, and the node before it
+// on that path. Distances are infinity and parents npos for nodes the
+// search didn't reach, and the source is its own parent.
+struct sssp_result {
+    std::vector<double> distances;
+    std::vector<std::size_t> parents;
+};
+
+// Dijkstra's algorithm over node indices, for a weighted_directed_graph, a
+// directed_graph or a compressed_graph copy of either. Edge weights must not
+// be negative.
+//
+// Distances and parents are kept in flat arrays indexed by node, and the
+// nodes still to settle in an indexed_heap, so a relaxation is a few array
+// accesses with no allocation. The arrays belong to the search object and
+// are kept between runs. Each run only resets the entries the previous one
+// touched, so a stream of queries made with one object costs in proportion
+// to the part of the graph each query explores, not to the graph's size. An
+// object must only be used by one thread at a time.
+class dijkstra_search {
+public:
+    using size_type = std::size_t;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    // Finds the distances from source to every node it can reach
+    template<typename Graph>
+    void run(const Graph& graph, node_id source);
+
+    // Searches from source only until the distance to target is known, and
+    // returns it, or infinity if target can't be reached. Nodes farther
+    // away than target are left with upper bounds on their distances.
+    template<typename Graph>
+    double run(const Graph& graph, node_id source, node_id target);
+
+    // The distance to node found by the last run, or infinity
+    [[nodiscard]] double distance(size_type node) const;
+
+    // The node before node on the path found by the last run, or npos
+    [[nodiscard]] size_type parent(size_type node) const;
+
+    [[nodiscard]] bool reached(size_type node) const;
+
+    // The nodes on the path found by the last run from its source to node,
+    // or nothing if node wasn't reached
+    [[nodiscard]] std::vector<size_type> path(size_type node) const;
+
+    // Number of nodes the last run settled, as a measure of its work
+    [[nodiscard]] size_type settled_count() const noexcept;
+
+private:
+    template<typename Graph>
+    friend sssp_result dijkstra(const Graph& graph, node_id source);
+
+    details::dijkstra_state m_state;
+    size_type m_settled{ 0 };
+
+    template<typename Graph>
+    void search(const Graph& graph, size_type source, size_type target);
+};
+
+// Distances from source to every node, by Dijkstra's algorithm. For many
+// searches over the same graph, keep one dijkstra_search and run it for
+// each instead.
+template<typename Graph>
+[[nodiscard]] sssp_result dijkstra(const Graph& graph, node_id source);
+
+// A path through a graph: the indices of its nodes, from its source to its
+// target, and its total weight. A path that doesn't exist has no nodes and
+// an infinite cost.
+struct weighted_path {
+    std::vector<std::size_t> nodes;
+    double cost;
+};
+
+// Point-to-point queries by bidirectional Dijkstra, for a
+// weighted_directed_graph or a compressed_graph, whose in-edges are
+// searched backwards from the target while out-edges are searched forwards
+// from the source. Each step advances whichever search has the nearer
+// frontier, and the query stops once the two frontiers' distances add up
+// to at least the shortest connection seen so far. Each search only covers
+// about half the distance, which on road-like graphs settles several times
+// fewer nodes than searching from the source alone. Edge weights must not
+// be negative.
+//
+// As with dijkstra_search, both searches' arrays are kept between queries
+// and only the touched entries reset, and an object must only be used by
+// one thread at a time.
+class bidirectional_dijkstra_search {
+public:
+    using size_type = std::size_t;
+
+    // Returns a shortest path from source to target
+    template<typename Graph>
+    weighted_path run(const Graph& graph, node_id source, node_id target);
+
+    // Number of nodes the last query settled, in both directions
+    [[nodiscard]] size_type settled_count() const noexcept;
+
+private:
+    details::dijkstra_state m_forward;
+    details::dijkstra_state m_backward;
+    size_type m_settled{ 0 };
+
+    // Settles the nearest node in state's frontier. Connections it finds to
+    // nodes the other search has reached that are shorter than best replace
+    // best, and the node they meet at replaces meeting.
+    template<bool Reverse, typename Graph>
+    void expand(const Graph& graph, details::dijkstra_state& state,
+                const details::dijkstra_state& other, double& best,
+                size_type& meeting);
+};
+
+// A shortest path from source to target, by bidirectional Dijkstra. For
+// many queries over the same graph, keep one bidirectional_dijkstra_search
+// and run it for each instead.
+template<typename Graph>
+[[nodiscard]] weighted_path
+bidirectional_dijkstra(const Graph& graph, node_id source, node_id target);
+
+// Point-to-point queries by A*, for a weighted_directed_graph, a
+// directed_graph or a compressed_graph. The heuristic is called as
+// heuristic(node) with a node index, and estimates the distance from that
+// node to the target; for nodes with positions, such as grid or map
+// coordinates, the straight-line distance to the target is the usual
+// choice. Nodes are settled in order of distance plus estimate, so the
+// search heads towards the target and stops as soon as it is settled.
+//
+// The path found is a shortest one as long as the heuristic never
+// overestimates. If it is also consistent, so that no estimate falls by
+// more than the weight of an edge, every node is settled at most once;
+// otherwise nodes are reopened when a shorter path to them turns up. The
+// heuristic is called once per node reached, and its results are kept in
+// a flat array alongside the distances. As with dijkstra_search, the
+// arrays are kept between queries and an object must only be used by one
+// thread at a time.
+class astar_search {
+public:
+    using size_type = std::size_t;
+
+    // Returns a shortest path from source to target
+    template<typename Graph, typename Heuristic>
+    weighted_path run(const Graph& graph, node_id source, node_id target,
+                      Heuristic&& heuristic);
+
+    // Number of nodes the last query settled, counting reopened nodes
+    // each time
+    [[nodiscard]] size_type settled_count() const noexcept;
+
+private:
+    details::dijkstra_state m_state;
+    // The heuristic's estimate for each node the last query reached
+    std::vector<double> m_estimates;
+    size_type m_settled{ 0 };
+};
+
+// A shortest path from source to target, by A*. For many queries over the
+// same graph, keep one astar_search and run it for each instead.
+template<typename Graph, typename Heuristic>
+[[nodiscard]] weighted_path astar(const Graph& graph, node_id source,
+                                  node_id target, Heuristic&& heuristic);
+
+// Parallel delta-stepping (Meyer and Sanders) from source, spread over pool.
+// Returns the same distances as dijkstra, with infinity for nodes that
+// can't be reached. Edge weights must not be negative.
+//
+// Nodes are kept in buckets of width delta by tentative distance, and the
+// lowest bucket is settled as a whole, in parallel, instead of one node at a
+// time. Light edges, of weight up to delta, can lead back into the bucket
+// being settled, so they are relaxed in rounds until it stays empty. Heavy
+// edges can't, so they are relaxed once per node, after its bucket is
+// settled. A small delta does less redundant work but has less
+// parallelism in each round; the default, for delta <= 0, is the largest
+// edge weight divided by the average out-degree. Only a bounded window of
+// buckets is kept, so memory doesn't grow with the longest distance over
+// delta.
+template<typename Graph>
+[[nodiscard]] std::vector<double>
+delta_stepping(const Graph& graph, node_id source, double delta = 0,
+               thread_pool& pool = default_thread_pool());
+
+template<typename Graph>
+void dijkstra_search::run(const Graph& graph, node_id source) {
+    search(graph, source.index, npos);
+}
+
+template<typename Graph>
+double dijkstra_search::run(const Graph& graph, node_id source,
+                            node_id target) {
+    search(graph, source.index, target.index);
+    return target.index < m_state.distances.size()
+               ? m_state.distances[target.index]
+               : std::numeric_limits<double>::infinity();
+}
+
+inline double dijkstra_search::distance(size_type node) const {
+    return m_state.distances[node];
+}
+
+inline dijkstra_search::size_type
+dijkstra_search::parent(size_type node) const {
+    return m_state.parents[node];
+}
+
+inline bool dijkstra_search::reached(size_type node) const {
+    return m_state.reached(node);
+}
+
+inline std::vector<dijkstra_search::size_type>
+dijkstra_search::path(size_type node) const {
+    std::vector<size_type> nodes;
+    if (!reached(node)) { return nodes; }
+    m_state.append_path(node, nodes);
+    std::reverse(std::begin(nodes), std::end(nodes));
+    return nodes;
+}
+
+inline dijkstra_search::size_type
+dijkstra_search::settled_count() const noexcept {
+    return m_settled;
+}
+
+template<typename Graph>
+void dijkstra_search::search(const Graph& graph, size_type source,
+                             size_type target) {
+    m_state.reset(graph.size());
+    m_settled = 0;
+    if (source >= graph.size()) { return; }
+
+    auto& heap{ m_state.heap };
+    m_state.relax(source, 0, source);
+    while (!heap.empty()) {
+        const auto node{ heap.top() };
+        const auto distance{ heap.top_key() };
+        heap.pop();
+        ++m_settled;
+        if (node == target) { break; }
+
+        details::for_each_weighted_edge(
+            graph, node, [&](size_type to, double weight) {
+                m_state.relax(to, distance + weight, node);
+            });
+    }
+}
+
+template<typename Graph>
+sssp_result dijkstra(const Graph& graph, node_id source) {
+    dijkstra_search search;
+    search.run(graph, source);
+    return { std::move(search.m_state.distances),
+             std::move(search.m_state.parents) };
+}
+
+template<typename Graph>
+weighted_path bidirectional_dijkstra_search::run(const Graph& graph,
+                                                 node_id source,
+                                                 node_id target) {
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    constexpr auto npos{ details::dijkstra_state::npos };
+    m_forward.reset(graph.size());
+    m_backward.reset(graph.size());
+    m_settled = 0;
+    weighted_path path{ {}, infinity };
+    if (source.index >= graph.size() || target.index >= graph.size()) {
+        return path;
+    }
+
+    m_forward.relax(source.index, 0, source.index);
+    m_backward.relax(target.index, 0, target.index);
+    // The shortest connection between the two searches found so far, and
+    // the node where they meet on it
+    auto best{ source.index == target.index ? 0 : infinity };
+    auto meeting{ source.index == target.index ? source.index : npos };
+
+    while (!m_forward.heap.empty() && !m_backward.heap.empty()) {
+        const auto forward_key{ m_forward.heap.top_key() };
+        const auto backward_key{ m_backward.heap.top_key() };
+        // Any connection not yet seen must pass through both frontiers
+        if (forward_key + backward_key >= best) { break; }
+        if (forward_key <= backward_key) {
+            expand<false>(graph, m_forward, m_backward, best, meeting);
+        } else {
+            expand<true>(graph, m_backward, m_forward, best, meeting);
+        }
+    }
+    if (meeting == npos) { return path; }
+
+    m_forward.append_path(meeting, path.nodes);
+    std::reverse(std::begin(path.nodes), std::end(path.nodes));
+    // The backward search's parents lead on towards the target
+    for (auto node{ meeting }; node != target.index;) {
+        node = m_backward.parents[node];
+        path.nodes.push_back(node);
+    }
+    path.cost = best;
+    return path;
+}
+
+template<bool Reverse, typename Graph>
+void bidirectional_dijkstra_search::expand(
+    const Graph& graph, details::dijkstra_state& state,
+    const details::dijkstra_state& other, double& best, size_type& meeting) {
+    const auto node{ state.heap.top() };
+    const auto distance{ state.heap.top_key() };
+    state.heap.pop();
+    ++m_settled;
+    details::for_each_weighted_edge<Reverse>(
+        graph, node, [&](size_type next, double weight) {
+            state.relax(next, distance + weight, node);
+            if (!other.reached(next)) { return; }
+            const auto total{ state.distances[next] + other.distances[next] };
+            if (total < best) {
+                best = total;
+                meeting = next;
+            }
+        });
+}
+
+inline bidirectional_dijkstra_search::size_type
+bidirectional_dijkstra_search::settled_count() const noexcept {
+    return m_settled;
+}
+
+template<typename Graph>
+weighted_path bidirectional_dijkstra(const Graph& graph, node_id source,
+                                     node_id target) {
+    bidirectional_dijkstra_search search;
+    return search.run(graph, source, target);
+}
+
+template<typename Graph>
+std::vector<double> delta_stepping(const Graph& graph, node_id source,
+                                   double delta, thread_pool& pool) {
+    using size_type = std::size_t;
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    const auto n{ graph.size() };
+    std::vector<double> distances(n, infinity);
+    if (source.index >= n) { return distances; }
+
+    if (!(delta > 0)) {
+        std::vector<double> max_weights(pool.size(), 0);
+        std::vector<size_type> edge_counts(pool.size(), 0);
+        pool.parallel_for_chunks(
+            0, n,
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto node{ first }; node < last; ++node) {
+                    details::for_each_weighted_edge(
+                        graph, node, [&](size_type, double weight) {
+                            max_weights[worker] =
+                                std::max(max_weights[worker], weight);
+                            ++edge_counts[worker];
+                        });
+                }
+            },
+            256);
+        double max_weight{ 0 };
+        size_type edge_count{ 0 };
+        for (size_type w{ 0 }; w < pool.size(); ++w) {
+            max_weight = std::max(max_weight, max_weights[w]);
+            edge_count += edge_counts[w];
+        }
+        delta = max_weight > 0 ? max_weight * n / edge_count : 1;
+    }
+
+    // Split the edges into light and heavy ones up front, so that each
+    // kind of relaxation only scans its own edges
+    details::weighted_edge_rows light;
+    details::weighted_edge_rows heavy;
+    light.offsets.assign(n + 1, 0);
+    heavy.offsets.assign(n + 1, 0);
+    pool.parallel_for(
+        0, n,
+        [&](size_type node) {
+            details::for_each_weighted_edge(
+                graph, node, [&](size_type, double weight) {
+                    ++(weight <= delta ? light : heavy).offsets[node + 1];
+                });
+        },
+        256);
+    for (size_type node{ 0 }; node < n; ++node) {
+        light.offsets[node + 1] += light.offsets[node];
+        heavy.offsets[node + 1] += heavy.offsets[node];
+    }
+    for (auto* rows: { &light, &heavy }) {
+        rows->targets.resize(rows->offsets[n]);
+        rows->weights.resize(rows->offsets[n]);
+    }
+    std::vector<double> max_heavy_weights(pool.size(), 0);
+    pool.parallel_for_chunks(
+        0, n,
+        [&](size_type worker, size_type first, size_type last) {
+            for (auto node{ first }; node < last; ++node) {
+                auto light_position{ light.offsets[node] };
+                auto heavy_position{ heavy.offsets[node] };
+                details::for_each_weighted_edge(
+                    graph, node, [&](size_type to, double weight) {
+                        auto& rows{ weight <= delta ? light : heavy };
+                        auto& position{ weight <= delta ? light_position
+                                                        : heavy_position };
+                        rows.targets[position] = to;
+                        rows.weights[position] = weight;
+                        ++position;
+                        if (weight > delta) {
+                            max_heavy_weights[worker] =
+                                std::max(max_heavy_weights[worker], weight);
+                        }
+                    });
+            }
+        },
+        256);
+
+    // Buckets, indexed by distance / delta, are kept in a cyclic window
+    // starting at the current one. It is wide enough for any relaxation
+    // along an edge of up to the largest weight, but capped, so that its
+    // size doesn't grow with the largest distance over delta. Relaxations
+    // that land past the window go on an overflow list instead, which is
+    // refiled once nothing in the window comes before it, jumping straight
+    // to the lowest bucket it holds.
+    //
+    // Each worker files the nodes it improves in its own buckets, which are
+    // gathered between rounds. A node is filed again each time its
+    // distance drops, so buckets can hold stale entries; the distance each
+    // node last had its edges relaxed at is what keeps those from being
+    // expanded twice.
+    constexpr size_type max_window{ 4096 };
+    double max_weight{ delta };
+    for (auto weight: max_heavy_weights) {
+        max_weight = std::max(max_weight, weight);
+    }
+    const auto window{ static_cast<size_type>(
+        std::min(std::ceil(max_weight / delta) + 1,
+                 static_cast<double>(max_window))) };
+    const auto bucket_of{ [delta](double distance) {
+        // Clamped, so that a huge distance over a tiny delta can't overflow
+        return static_cast<size_type>(
+            std::min(distance / delta, 0x1p62));
+    } };
+    std::vector<std::vector<std::vector<size_type>>> buckets(
+        pool.size(), std::vector<std::vector<size_type>>(window));
+    std::vector<std::vector<size_type>> overflow(pool.size());
+    // The lowest bucket each worker has put on its overflow list
+    std::vector<size_type> overflow_min(pool.size(), compressed_graph::npos);
+    std::vector<double> relaxed_at(n, infinity);
+    // Nodes settled in the current bucket, whose heavy edges are left
+    std::vector<std::vector<size_type>> settled(pool.size());
+    details::node_bitset settled_bits{ n };
+    size_type current{ 0 };
+
+    auto relax{ [&](size_type worker, size_type to, double candidate) {
+        if (!details::atomic_lower(distances[to], candidate)) { return; }
+        // Distances never fall below the current bucket's
+        const auto bucket{ bucket_of(candidate) };
+        if (bucket - current < window) {
+            buckets[worker][bucket % window].push_back(to);
+        } else {
+            overflow[worker].push_back(to);
+            overflow_min[worker] = std::min(overflow_min[worker], bucket);
+        }
+    } };
+    auto relax_edges{ [&](size_type worker,
+                          const details::weighted_edge_rows& rows,
+                          size_type node, double distance) {
+        for (auto i{ rows.offsets[node] }; i < rows.offsets[node + 1]; ++i) {
+            relax(worker, rows.targets[i], distance + rows.weights[i]);
+        }
+    } };
+    auto gather{ [](std::vector<size_type>& nodes,
+                    std::vector<size_type>& worker_nodes) {
+        nodes.insert(std::end(nodes), std::begin(worker_nodes),
+                     std::end(worker_nodes));
+        worker_nodes.clear();
+    } };
+
+    distances[source.index] = 0;
+    std::vector<size_type> frontier{ source.index };
+    std::vector<size_type> heavy_frontier;
+    std::vector<size_type> far;
+    while (true) {
+        // Light rounds, until nothing more falls into the current bucket
+        while (!frontier.empty()) {
+            pool.parallel_for_chunks(
+                0, frontier.size(),
+                [&](size_type worker, size_type first, size_type last) {
+                    for (auto i{ first }; i < last; ++i) {
+                        const auto node{ frontier[i] };
+                        const auto distance{
+                            std::atomic_ref{ distances[node] }.load(
+                                std::memory_order_relaxed) };
+                        if (!details::atomic_lower(relaxed_at[node],
+                                                   distance)) {
+                            continue;
+                        }
+                        if (settled_bits.atomic_set(node)) {
+                            settled[worker].push_back(node);
+                        }
+                        relax_edges(worker, light, node, distance);
+                    }
+                },
+                64);
+            frontier.clear();
+            for (auto& worker_buckets: buckets) {
+                gather(frontier, worker_buckets[current % window]);
+            }
+        }
+
+        // The bucket's distances are now final, so relax its heavy edges
+        heavy_frontier.clear();
+        for (auto& nodes: settled) { gather(heavy_frontier, nodes); }
+        pool.parallel_for_chunks(
+            0, heavy_frontier.size(),
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto i{ first }; i < last; ++i) {
+                    const auto node{ heavy_frontier[i] };
+                    relax_edges(worker, heavy, node, distances[node]);
+                }
+            },
+            64);
+
+        // The next bucket is the first non-empty one in the window, unless
+        // the overflow list might hold an earlier one
+        const auto end{ current + window };
+        auto limit{ end };
+        for (auto bucket: overflow_min) { limit = std::min(limit, bucket); }
+        const auto first_filed{ [&](size_type first, size_type last) {
+            for (auto b{ first }; b < last; ++b) {
+                for (auto& worker_buckets: buckets) {
+                    if (!worker_buckets[b % window].empty()) { return b; }
+                }
+            }
+            return last;
+        } };
+        auto next{ first_filed(current + 1, limit) };
+        if (next == limit) {
+            // Refile the overflow list, dropping entries whose nodes have
+            // already been expanded at their final distances, and move the
+            // window to the lowest bucket in it or left in the window
+            far.clear();
+            for (auto& nodes: overflow) { gather(far, nodes); }
+            std::fill(std::begin(overflow_min), std::end(overflow_min),
+                      compressed_graph::npos);
+            next = compressed_graph::npos;
+            std::erase_if(far, [&](size_type node) {
+                if (relaxed_at[node] <= distances[node]) { return true; }
+                next = std::min(next, bucket_of(distances[node]));
+                return false;
+            });
+            if (limit < end) {
+                const auto filed{ first_filed(limit, std::min(end, next)) };
+                if (filed < end) { next = filed; }
+            }
+            if (next == compressed_graph::npos) { break; }
+            for (auto node: far) {
+                const auto bucket{ bucket_of(distances[node]) };
+                if (bucket - next < window) {
+                    buckets[0][bucket % window].push_back(node);
+                } else {
+                    overflow[0].push_back(node);
+                    overflow_min[0] = std::min(overflow_min[0], bucket);
+                }
+            }
+        }
+        current = next;
+        for (auto& worker_buckets: buckets) {
+            gather(frontier, worker_buckets[current % window]);
+        }
+    }
+    return distances;
+}
+
+template<typename Graph, typename Heuristic>
+weighted_path astar_search::run(const Graph& graph, node_id source,
+                                node_id target, Heuristic&& heuristic) {
+    m_state.reset(graph.size());
+    m_estimates.resize(graph.size());
+    m_settled = 0;
+    weighted_path path{ {}, std::numeric_limits<double>::infinity() };
+    if (source.index >= graph.size() || target.index >= graph.size()) {
+        return path;
+    }
+
+    auto& heap{ m_state.heap };
+    m_estimates[source.index] = heuristic(source.index);
+    m_state.relax(source.index, 0, source.index, m_estimates[source.index]);
+    while (!heap.empty()) {
+        const auto node{ heap.top() };
+        heap.pop();
+        ++m_settled;
+        if (node == target.index) { break; }
+
+        const auto distance{ m_state.distances[node] };
+        details::for_each_weighted_edge(
+            graph, node, [&](size_type to, double weight) {
+                const auto candidate{ distance + weight };
+                if (!(candidate < m_state.distances[to])) { return; }
+                if (!m_state.reached(to)) { m_estimates[to] = heuristic(to); }
+                m_state.relax(to, candidate, node,
+                              candidate + m_estimates[to]);
+            });
+    }
+    if (!m_state.reached(target.index)) { return path; }
+
+    m_state.append_path(target.index, path.nodes);
+    std::reverse(std::begin(path.nodes), std::end(path.nodes));
+    path.cost = m_state.distances[target.index];
+    return path;
+}
+
+inline astar_search::size_type astar_search::settled_count() const noexcept {
+    return m_settled;
+}
+
+template<typename Graph, typename Heuristic>
+weighted_path astar(const Graph& graph, node_id source, node_id target,
+                    Heuristic&& heuristic) {
+    astar_search search;
+    return search.run(graph, source, target,
+                      std::forward<Heuristic>(heuristic));
+}
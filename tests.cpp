@@ -0,0 +1,1450 @@
+//
+// Cross-checks of the graph types and algorithms on random graphs, each
+// against a simpler reference: a plain breadth-first search, dijkstra, or
+// the same changes made one at a time. Edge weights are whole numbers, so
+// that distances found by adding them up in different orders compare
+// exactly.
+//
+#include "all_pairs_shortest_paths.h"
+#include "bellman_ford.h"
+#include "compressed_graph.h"
+#include "concurrent_directed_graph.h"
+#include "contraction_hierarchy.h"
+#include "directed_graph.h"
+#include "directed_graph_builder.h"
+#include "graph_batch.h"
+#include "graph_common.h"
+#include "graph_traversal.h"
+#include "landmarks.h"
+#include "shortest_paths.h"
+#include "thread_pool.h"
+#include "topological_sort.h"
+#include "versioned_directed_graph.h"
+#include "weighted_directed_graph.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr auto infinity{ std::numeric_limits<double>::infinity() };
+    constexpr auto npos{ static_cast<std::size_t>(-1) };
+
+    int failures{ 0 };
+
+    void expect(bool condition, std::string_view what) {
+        if (!condition) {
+            ++failures;
+            std::cerr << "FAILED: " << what << '\n';
+        }
+    }
+
+    // A graph of n nodes, valued 0 to n - 1 so that values and indices
+    // agree, with about m edges of whole weights below max_weight. With
+    // acyclic, edges only lead from lower to higher nodes.
+    weighted_directed_graph<int> random_weighted_graph(std::mt19937& rng,
+                                                       std::size_t n,
+                                                       std::size_t m,
+                                                       int max_weight,
+                                                       bool acyclic = false) {
+        weighted_directed_graph<int> graph;
+        for (std::size_t i{ 0 }; i < n; ++i) {
+            graph.insert(static_cast<int>(i));
+        }
+        for (std::size_t k{ 0 }; k < m; ++k) {
+            auto from{ rng() % n };
+            auto to{ rng() % n };
+            if (acyclic) {
+                if (from == to) { continue; }
+                if (from > to) { std::swap(from, to); }
+            }
+            graph.insert_or_assign_edge(node_id{ from }, node_id{ to },
+                                        static_cast<double>(rng() %
+                                                            max_weight));
+        }
+        return graph;
+    }
+
+    directed_graph<int> random_graph(std::mt19937& rng, std::size_t n,
+                                     std::size_t m, bool acyclic = false) {
+        directed_graph<int> graph;
+        for (std::size_t i{ 0 }; i < n; ++i) {
+            graph.insert(static_cast<int>(i));
+        }
+        for (std::size_t k{ 0 }; k < m; ++k) {
+            auto from{ rng() % n };
+            auto to{ rng() % n };
+            if (acyclic) {
+                if (from == to) { continue; }
+                if (from > to) { std::swap(from, to); }
+            }
+            graph.insert_edge(node_id{ from }, node_id{ to });
+        }
+        return graph;
+    }
+
+    // The adjacency views walk the same neighbours as the accessors that
+    // copy them into a set
+    void test_adjacency_views(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            const auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const auto weighted{ random_weighted_graph(rng, n,
+                                                       rng() % (3 * n), 50) };
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                const auto value{ static_cast<int>(node) };
+                const auto expected{ graph.get_adjacent_nodes_values(value) };
+                std::set<int, std::less<>> values;
+                for (auto&& to: graph.adjacent_nodes(value)) {
+                    values.insert(to);
+                }
+                std::set<int, std::less<>> indices;
+                for (auto to: graph.adjacent_node_indices(value)) {
+                    indices.insert(graph.value(to));
+                }
+                expect(values == expected && indices == expected,
+                       "directed_graph adjacency views");
+
+                std::set<std::pair<int, double>, std::less<>> edges;
+                for (auto&& edge: weighted.adjacent_nodes(value)) {
+                    edges.emplace(edge.node, edge.weight);
+                }
+                expect(edges ==
+                           weighted.get_adjacent_nodes_values_and_weights(
+                               value),
+                       "weighted_directed_graph adjacency view");
+            }
+            expect(graph.adjacent_nodes(-1).empty() &&
+                       graph.adjacent_node_indices(-1).empty() &&
+                       weighted.adjacent_nodes(-1).empty(),
+                   "adjacency views of a missing node are empty");
+        }
+    }
+
+    // out_edges yields each edge's target index and weight, in order of
+    // target
+    void test_weighted_edge_views(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (3 * n),
+                                                    50) };
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                std::vector<std::pair<int, double>> edges;
+                for (auto&& edge: graph.out_edges(node)) {
+                    edges.emplace_back(graph.value(edge.index()),
+                                       edge.weight());
+                }
+                expect(std::ranges::is_sorted(edges) &&
+                           std::ranges::equal(
+                               edges,
+                               graph.get_adjacent_nodes_values_and_weights(
+                                   graph.value(node))),
+                       "out_edges match the weighted adjacency");
+            }
+        }
+    }
+
+    // The index-based overloads act like the value-based ones
+    void test_index_api(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            const std::size_t m{ rng() % (3 * n) };
+            // The second graph is built from the same draws rather than
+            // copied, as a copy's nodes still refer to the original graph
+            auto replay{ rng };
+            auto by_index{ random_graph(rng, n, m) };
+            auto by_value{ random_graph(replay, n, m) };
+            for (int k{ 0 }; k < 40; ++k) {
+                const node_id from{ rng() % n };
+                const node_id to{ rng() % n };
+                const auto from_value{ by_value.value(from.index) };
+                const auto to_value{ by_value.value(to.index) };
+                if (rng() % 2 == 0) {
+                    expect(by_index.insert_edge(from, to) ==
+                               by_value.insert_edge(from_value, to_value),
+                           "insert_edge by index");
+                } else {
+                    expect(by_index.erase_edge(from, to) ==
+                               by_value.erase_edge(from_value, to_value),
+                           "erase_edge by index");
+                }
+            }
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                const auto value{ by_index.value(node) };
+                std::set<int, std::less<>> targets;
+                for (auto to: by_index.out_edges(node)) {
+                    targets.insert(by_index.value(to));
+                }
+                expect(by_index.index_of(value) == node &&
+                           targets == by_value.get_adjacent_nodes_values(value),
+                       "index and value overloads agree");
+            }
+            expect(by_index.index_of(static_cast<int>(n)) == by_index.npos,
+                   "index_of a missing value");
+        }
+
+        directed_graph<int> graph;
+        graph.insert(1);
+        graph.insert(2);
+        expect(graph.insert_edge(1, 2) && !graph.insert_edge(1, 2),
+               "duplicate edge rejected");
+        expect(graph.erase_edge(1, 2) && !graph.erase_edge(1, 2),
+               "erase_edge reports a missing edge");
+        weighted_directed_graph<int> weighted;
+        weighted.insert(1);
+        weighted.insert(2);
+        expect(weighted.insert_edge(node_id{ 0 }, node_id{ 1 }, 1) &&
+                   weighted.erase_edge(1, 2) &&
+                   !weighted.erase_edge(node_id{ 0 }, node_id{ 1 }),
+               "weighted erase_edge reports a missing edge");
+    }
+
+    // Graphs with the same nodes and edges are equal whatever order they
+    // were built in, and a single change tells them apart
+    void test_equality(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            std::vector<int> values;
+            for (std::size_t i{ 0 }; i < n; ++i) {
+                values.push_back(static_cast<int>(i));
+            }
+            std::map<std::pair<int, int>, double> weights;
+            for (std::size_t k{ 0 }; k < 3 * n; ++k) {
+                const auto from{ static_cast<int>(rng() % n) };
+                const auto to{ static_cast<int>(rng() % n) };
+                weights.emplace(std::pair{ from, to }, rng() % 50);
+            }
+            std::vector<std::pair<std::pair<int, int>, double>> edges(
+                std::begin(weights), std::end(weights));
+
+            weighted_directed_graph<int> graph;
+            for (auto value: values) { graph.insert(value); }
+            for (auto [edge, weight]: edges) {
+                graph.insert_edge(edge.first, edge.second, weight);
+            }
+            std::ranges::shuffle(values, rng);
+            std::ranges::shuffle(edges, rng);
+            weighted_directed_graph<int> shuffled;
+            for (auto value: values) { shuffled.insert(value); }
+            for (auto [edge, weight]: edges) {
+                shuffled.insert_edge(edge.first, edge.second, weight);
+            }
+            expect(graph == shuffled && !graph.first_difference(shuffled),
+                   "equality ignores order");
+
+            const auto [from, to]{ edges.front().first };
+            shuffled.set_edge_weight(from, to, edges.front().second + 1);
+            const auto difference{ graph.first_difference(shuffled) };
+            expect(graph != shuffled && difference &&
+                       difference->what == graph_difference::kind::edge_weight,
+                   "equality sees a changed weight");
+            shuffled.erase_edge(from, to);
+            expect(graph != shuffled, "equality sees a missing edge");
+        }
+    }
+
+    // The fingerprint depends only on the nodes and edges, not on the
+    // changes that led to them
+    void test_fingerprint(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const auto before{ graph.fingerprint() };
+            const node_id from{ rng() % n };
+            const node_id to{ rng() % n };
+            if (graph.insert_edge(from, to)) {
+                expect(graph.fingerprint() != before,
+                       "fingerprint reflects a new edge");
+                graph.erase_edge(from, to);
+            }
+            expect(graph.fingerprint() == before,
+                   "fingerprint restored by undoing a change");
+
+            // Erasing a node matches building the graph without it
+            graph.erase(static_cast<int>(rng() % n));
+            directed_graph<int> rebuilt;
+            for (auto i{ graph.size() }; i-- > 0;) {
+                rebuilt.insert(graph.value(i));
+            }
+            for (std::size_t i{ 0 }; i < graph.size(); ++i) {
+                for (auto target: graph.out_edges(i)) {
+                    rebuilt.insert_edge(graph.value(i), graph.value(target));
+                }
+            }
+            expect(graph.fingerprint() == rebuilt.fingerprint(),
+                   "fingerprint after erase");
+
+            auto weighted{ random_weighted_graph(rng, n, rng() % (3 * n),
+                                                 50) };
+            const auto weighted_before{ weighted.fingerprint() };
+            const auto weight{ weighted.edge_weight(from, to) };
+            if (weight) {
+                weighted.set_edge_weight(from, to, *weight + 1);
+                expect(weighted.fingerprint() != weighted_before,
+                       "fingerprint reflects a weight");
+                weighted.set_edge_weight(from, to, *weight);
+                expect(weighted.fingerprint() == weighted_before,
+                       "fingerprint restored with the weight");
+            }
+        }
+
+        // Writes through the non-const accessors go through set_value(),
+        // so lookups and the fingerprint stay current, and a value another
+        // node has is refused
+        directed_graph<int> graph;
+        graph.insert(1);
+        graph.insert(2);
+        graph.insert_edge(1, 2);
+        graph[0] = 3;
+        *graph.begin(3) = 4;
+        graph.at(1) = 3;
+        directed_graph<int> expected;
+        expected.insert(3);
+        expected.insert(4);
+        expected.insert_edge(3, 4);
+        expect(graph[0] == 3 && graph.index_of(4) == 1 &&
+                   graph.index_of(1) == graph.npos && graph == expected &&
+                   graph.fingerprint() == expected.fingerprint(),
+               "writes through operator[] and adjacent iterators");
+
+        weighted_directed_graph<int> weighted;
+        weighted.insert(1);
+        weighted.at(0) = 2;
+        expect(weighted[0] == 2 && weighted.index_of(2) == 0 &&
+                   weighted.index_of(1) == weighted.npos,
+               "writes through weighted operator[]");
+    }
+
+    // Each snapshot matches a directed_graph given the same changes
+    void test_versioned_graph(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            versioned_directed_graph<int> versioned;
+            directed_graph<int> expected;
+            const auto values{ static_cast<int>(5 + rng() % 300) };
+            for (int k{ 0 }; k < 1500; ++k) {
+                const auto a{ static_cast<int>(rng() % values) };
+                const auto b{ static_cast<int>(rng() % values) };
+                switch (rng() % 10) {
+                case 0:
+                case 1:
+                case 2:
+                    expect(versioned.insert(a) == expected.insert(a).second,
+                           "versioned insert");
+                    break;
+                case 3:
+                    expect(versioned.erase(a) == expected.erase(a),
+                           "versioned erase");
+                    break;
+                case 8:
+                    expect(versioned.erase_edge(a, b) ==
+                               expected.erase_edge(a, b),
+                           "versioned erase_edge");
+                    break;
+                case 9:
+                    if (rng() % 10 == 0) { versioned.compact(); }
+                    break;
+                default:
+                    expect(versioned.insert_edge(a, b) ==
+                               expected.insert_edge(a, b),
+                           "versioned insert_edge");
+                }
+                if (k % 100 != 0) { continue; }
+
+                versioned.commit();
+                const auto snapshot{ versioned.snapshot() };
+                expect(snapshot.size() == expected.size() &&
+                           snapshot.fingerprint() == expected.fingerprint(),
+                       "snapshot matches directed_graph");
+                for (std::size_t i{ 0 }; i < snapshot.slot_count(); ++i) {
+                    if (!snapshot.contains(i)) { continue; }
+                    const auto index{ expected.index_of(snapshot.value(i)) };
+                    expect(snapshot.index_of(snapshot.value(i)) == i &&
+                               index != expected.npos,
+                           "snapshot index_of");
+                    std::set<int, std::less<>> targets;
+                    for (auto to: snapshot.out_edges(i)) {
+                        targets.insert(snapshot.value(to));
+                    }
+                    expect(index != expected.npos &&
+                               targets == expected.get_adjacent_nodes_values(
+                                              snapshot.value(i)),
+                           "snapshot edges");
+                }
+            }
+        }
+    }
+
+    // Changes made from several threads add up to the same graph as
+    // making them one at a time
+    void test_concurrent_graph(std::mt19937& rng, thread_pool& pool) {
+        const std::size_t n{ 500 };
+        std::vector<std::pair<int, int>> edges;
+        for (std::size_t k{ 0 }; k < 3 * n; ++k) {
+            edges.emplace_back(static_cast<int>(rng() % n),
+                               static_cast<int>(rng() % n));
+        }
+        concurrent_directed_graph<int> graph{ 8 };
+        pool.parallel_for(
+            0, n,
+            [&](std::size_t i) { graph.insert(static_cast<int>(i)); }, 16);
+        pool.parallel_for(
+            0, edges.size(),
+            [&](std::size_t i) {
+                graph.insert_edge(edges[i].first, edges[i].second);
+            },
+            16);
+        pool.parallel_for(
+            0, edges.size() / 4,
+            [&](std::size_t i) {
+                graph.erase_edge(edges[i].first, edges[i].second);
+            },
+            16);
+
+        directed_graph<int> expected;
+        for (std::size_t i{ 0 }; i < n; ++i) {
+            expected.insert(static_cast<int>(i));
+        }
+        for (auto [from, to]: edges) { expected.insert_edge(from, to); }
+        for (std::size_t i{ 0 }; i < edges.size() / 4; ++i) {
+            expected.erase_edge(edges[i].first, edges[i].second);
+        }
+        const auto copy{ graph.to_directed_graph() };
+        expect(copy.size() == n &&
+                   copy.fingerprint() == expected.fingerprint(),
+               "concurrent_directed_graph matches directed_graph");
+        for (std::size_t i{ 0 }; i < n; ++i) {
+            const auto value{ static_cast<int>(i) };
+            expect(graph.get_adjacent_nodes_values(value) ==
+                       expected.get_adjacent_nodes_values(value),
+                   "concurrent_directed_graph edges");
+        }
+        expect(!graph.erase_edge(node_id{ 0 }, node_id{ graph.id_bound() }),
+               "concurrent erase_edge of a missing edge");
+    }
+
+    // Edges filed from several workers give the same graph as inserting
+    // them one at a time
+    void test_builder(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 20; ++round) {
+            const std::size_t n{ 1 + rng() % 300 };
+            const std::size_t m{ rng() % (2 * n) };
+            auto replay{ rng };
+            auto expected{ random_graph(rng, n, m) };
+            auto graph{ random_graph(replay, n, m) };
+            std::vector<std::pair<std::size_t, std::size_t>> edges;
+            for (std::size_t k{ 0 }; k < 4 * n; ++k) {
+                edges.emplace_back(rng() % n, rng() % n);
+            }
+            std::size_t inserted{ 0 };
+            for (auto [from, to]: edges) {
+                inserted += expected.insert_edge(node_id{ from },
+                                                 node_id{ to });
+            }
+
+            directed_graph_builder builder{ graph };
+            std::vector<directed_graph_builder<int>::edge_buffer*> buffers(
+                pool.size());
+            for (auto& buffer: buffers) { buffer = &builder.make_buffer(); }
+            pool.parallel_for_chunks(
+                0, edges.size(),
+                [&](std::size_t worker, std::size_t first, std::size_t last) {
+                    for (auto i{ first }; i < last; ++i) {
+                        buffers[worker]->insert_edge(
+                            node_id{ edges[i].first },
+                            node_id{ edges[i].second });
+                    }
+                },
+                16);
+            expect(builder.finalize(pool) == inserted,
+                   "builder counts new edges");
+            expect(graph == expected &&
+                       graph.fingerprint() == expected.fingerprint(),
+                   "builder matches insert_edge");
+        }
+    }
+
+    // A batch, applied at once, matches the same changes made one at a
+    // time in the order apply() documents: node insertions, then edge
+    // changes, then node erasures
+    void test_batch(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 50; ++round) {
+            const std::size_t n{ 1 + rng() % 60 };
+            const std::size_t m{ rng() % (3 * n) };
+            auto replay{ rng };
+            auto graph{ random_graph(rng, n, m) };
+            auto sequential{ random_graph(replay, n, m) };
+
+            graph_batch<int> batch;
+            std::vector<int> inserted;
+            std::vector<std::tuple<int, int, bool>> edge_changes;
+            std::vector<int> erased;
+            for (int k{ 0 }; k < 40; ++k) {
+                const auto a{ static_cast<int>(rng() % (n + 10)) };
+                const auto b{ static_cast<int>(rng() % (n + 10)) };
+                switch (rng() % 4) {
+                case 0:
+                    batch.insert(a);
+                    inserted.push_back(a);
+                    break;
+                case 1:
+                    batch.insert_edge(a, b);
+                    edge_changes.emplace_back(a, b, true);
+                    break;
+                case 2:
+                    batch.erase_edge(a, b);
+                    edge_changes.emplace_back(a, b, false);
+                    break;
+                default:
+                    batch.erase(a);
+                    erased.push_back(a);
+                }
+            }
+            for (auto value: inserted) { sequential.insert(value); }
+            for (auto [from, to, insert]: edge_changes) {
+                if (insert) {
+                    sequential.insert_edge(from, to);
+                } else {
+                    sequential.erase_edge(from, to);
+                }
+            }
+            for (auto value: erased) { sequential.erase(value); }
+            graph.apply(batch, pool);
+            expect(graph == sequential, "graph_batch matches one at a time");
+            expect(graph.fingerprint() == sequential.fingerprint(),
+                   "graph_batch fingerprint");
+        }
+
+        // Values without a std::hash are found by binary search instead
+        struct ordered {
+            int value;
+
+            auto operator<=>(const ordered&) const = default;
+        };
+        directed_graph<ordered> graph;
+        graph.insert(ordered{ 3 });
+        graph_batch<ordered> batch;
+        for (int value{ 0 }; value < 3; ++value) {
+            batch.insert(ordered{ value });
+            batch.insert_edge(ordered{ value }, ordered{ value + 1 });
+        }
+        batch.erase(ordered{ 0 });
+        graph.apply(batch, pool);
+        expect(graph.size() == 3 &&
+                   graph.has_edge(ordered{ 1 }, ordered{ 2 }) &&
+                   graph.has_edge(ordered{ 2 }, ordered{ 3 }) &&
+                   graph.out_degree(ordered{ 3 }) == 0,
+               "graph_batch without a hash");
+    }
+
+    // Weights are updated in place, and only on edges that exist
+    void test_weight_updates(std::mt19937& rng) {
+        for (int round{ 0 }; round < 50; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            auto graph{ random_weighted_graph(rng, n, rng() % (3 * n), 50) };
+            for (int k{ 0 }; k < 20; ++k) {
+                const node_id from{ rng() % n };
+                const node_id to{ rng() % n };
+                const auto weight{ static_cast<double>(rng() % 50) };
+                const auto old_weight{ graph.edge_weight(from, to) };
+                switch (rng() % 3) {
+                case 0:
+                    expect(graph.set_edge_weight(from, to, weight) ==
+                               old_weight.has_value(),
+                           "set_edge_weight only on existing edges");
+                    expect(graph.edge_weight(from, to) ==
+                               (old_weight ? std::optional{ weight }
+                                           : old_weight),
+                           "edge_weight after set_edge_weight");
+                    break;
+                case 1:
+                    expect(graph.insert_edge(from, to, weight) !=
+                               old_weight.has_value(),
+                           "insert_edge only adds new edges");
+                    expect(graph.edge_weight(from, to) ==
+                               old_weight.value_or(weight),
+                           "insert_edge keeps an existing weight");
+                    break;
+                default:
+                    expect(graph.insert_or_assign_edge(from, to, weight),
+                           "insert_or_assign_edge between existing nodes");
+                    expect(graph.edge_weight(from, to) == weight,
+                           "insert_or_assign_edge sets the weight");
+                }
+            }
+            auto copy{ graph };
+            expect(copy == graph && copy.fingerprint() == graph.fingerprint(),
+                   "weighted copy is equal");
+        }
+
+        // Erasing a node moves the later ones down, and assigning a graph
+        // copies values over old ones. With values that own memory, a value
+        // left behind shows up as a leak under LeakSanitizer.
+        weighted_directed_graph<std::string> names;
+        weighted_directed_graph<std::string> assigned;
+        for (char letter{ 'a' }; letter < 'z'; ++letter) {
+            names.insert(std::string(40, letter));
+            assigned.insert(std::string(50, letter));
+        }
+        names.insert_edge(std::string(40, 'b'), std::string(40, 'c'), 1);
+        names.erase(std::string(40, 'a'));
+        assigned = names;
+        expect(names.size() == 24 &&
+                   names.index_of(std::string(40, 'b')) == 0 &&
+                   names.edge_weight(node_id{ 0 }, node_id{ 1 }) == 1 &&
+                   assigned == names,
+               "erase and assignment with owning values");
+    }
+
+    // has_edge and edge_weight agree with the adjacency lists, and
+    // set_value keeps lookups by value working
+    void test_edge_lookup(std::mt19937& rng) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const auto weighted{ random_weighted_graph(rng, n,
+                                                       rng() % (3 * n), 50) };
+            for (std::size_t from{ 0 }; from < n; ++from) {
+                std::vector<char> targets(n, 0);
+                for (auto to: graph.out_edges(from)) { targets[to] = 1; }
+                std::vector<double> weights(n, -1);
+                for (auto&& edge: weighted.out_edges(from)) {
+                    weights[edge.index()] = edge.weight();
+                }
+                for (std::size_t to{ 0 }; to < n; ++to) {
+                    const auto value_from{ static_cast<int>(from) };
+                    const auto value_to{ static_cast<int>(to) };
+                    expect(graph.has_edge(node_id{ from }, node_id{ to }) ==
+                                   (targets[to] != 0) &&
+                               graph.has_edge(value_from, value_to) ==
+                                   (targets[to] != 0),
+                           "has_edge");
+                    const auto weight{ weighted.edge_weight(value_from,
+                                                            value_to) };
+                    expect(weighted.has_edge(node_id{ from }, node_id{ to }) ==
+                                   (weights[to] >= 0) &&
+                               weight == weighted.edge_weight(node_id{ from },
+                                                              node_id{ to }) &&
+                               weight.value_or(-1) == weights[to],
+                           "edge_weight");
+                }
+            }
+            expect(!graph.has_edge(-1, 0) && !weighted.edge_weight(0, -1),
+                   "edge lookups with a missing node");
+
+            // Changing a node's value matches building the graph with it
+            const auto index{ rng() % n };
+            const auto old_value{ graph.value(index) };
+            const auto new_value{ static_cast<int>(1000 + round) };
+            expect(graph.set_value(index, new_value), "set_value");
+            expect(graph.index_of(new_value) == index &&
+                       graph.index_of(old_value) == graph.npos,
+                   "value index follows set_value");
+            directed_graph<int> rebuilt;
+            for (std::size_t i{ 0 }; i < n; ++i) {
+                rebuilt.insert(graph.value(i));
+            }
+            for (std::size_t i{ 0 }; i < n; ++i) {
+                for (auto to: graph.out_edges(i)) {
+                    rebuilt.insert_edge(node_id{ i }, node_id{ to });
+                }
+            }
+            expect(graph == rebuilt &&
+                       graph.fingerprint() == rebuilt.fingerprint(),
+                   "set_value matches a rebuilt graph");
+            expect(n == 1 || !graph.set_value((index + 1) % n, new_value),
+                   "set_value rejects a duplicate");
+        }
+    }
+
+    // Degrees counted from the adjacency lists
+    template<typename Graph>
+    bool degrees_match(const Graph& graph) {
+        std::vector<std::size_t> in_degrees(graph.size(), 0);
+        for (std::size_t node{ 0 }; node < graph.size(); ++node) {
+            std::size_t out_degree{ 0 };
+            for (auto&& edge: graph.out_edges(node)) {
+                ++in_degrees[details::edge_target(edge)];
+                ++out_degree;
+            }
+            if (graph.out_degree(node_id{ node }) != out_degree ||
+                graph.out_degree(graph.value(node)) != out_degree) {
+                return false;
+            }
+        }
+        for (std::size_t node{ 0 }; node < graph.size(); ++node) {
+            if (graph.in_degree(node_id{ node }) != in_degrees[node] ||
+                graph.in_degree(graph.value(node)) != in_degrees[node]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The stored degrees follow every kind of change
+    void test_degrees(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 60 };
+            auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            auto weighted{ random_weighted_graph(rng, n, rng() % (3 * n),
+                                                 50) };
+            for (int k{ 0 }; k < 20; ++k) {
+                const node_id from{ rng() % n };
+                const node_id to{ rng() % n };
+                graph.erase_edge(from, to);
+                weighted.erase_edge(from, to);
+            }
+            expect(degrees_match(graph) && degrees_match(weighted),
+                   "degrees after erase_edge");
+
+            const auto erased{ static_cast<int>(rng() % n) };
+            graph.erase(erased);
+            weighted.erase(erased);
+            expect(degrees_match(graph) && degrees_match(weighted),
+                   "degrees after erase");
+
+            graph_batch<int> batch;
+            for (int k{ 0 }; k < 20; ++k) {
+                const auto a{ static_cast<int>(rng() % n) };
+                const auto b{ static_cast<int>(rng() % n) };
+                if (rng() % 2 == 0) {
+                    batch.insert_edge(a, b);
+                } else {
+                    batch.erase_edge(a, b);
+                }
+            }
+            graph.apply(batch, pool);
+            expect(degrees_match(graph), "degrees after apply");
+
+            directed_graph_builder builder{ graph };
+            auto& buffer{ builder.make_buffer() };
+            for (int k{ 0 }; k < 20 && !graph.empty(); ++k) {
+                buffer.insert_edge(node_id{ rng() % graph.size() },
+                                   node_id{ rng() % graph.size() });
+            }
+            builder.finalize(pool);
+            expect(degrees_match(graph), "degrees after the builder");
+        }
+    }
+
+    // A compressed_graph holds the same edges as the graph it copies
+    void test_compressed_graph(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 30; ++round) {
+            const std::size_t n{ 1 + rng() % 100 };
+            auto graph{ random_weighted_graph(rng, n, rng() % (4 * n), 20) };
+            compressed_graph compressed{ graph, pool };
+            std::size_t edges{ 0 };
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                const auto targets{ compressed.out_edges(node) };
+                const auto weights{ compressed.out_weights(node) };
+                std::size_t i{ 0 };
+                for (auto&& edge: graph.out_edges(node)) {
+                    expect(i < targets.size() && targets[i] == edge.index() &&
+                               weights[i] == edge.weight(),
+                           "compressed out-edges");
+                    ++i;
+                }
+                expect(i == targets.size(), "compressed out-degree");
+                for (auto from: compressed.in_edges(node)) {
+                    expect(graph.has_edge(node_id{ from }, node_id{ node }),
+                           "compressed in-edges");
+                }
+                edges += i;
+            }
+            expect(compressed.edge_count() == edges, "compressed edge count");
+        }
+    }
+
+    // Edge counts from source by the textbook queue-based search, with npos
+    // for nodes it can't reach
+    std::vector<std::size_t> plain_bfs(const directed_graph<int>& graph,
+                                       std::size_t source) {
+        std::vector<std::size_t> distances(graph.size(), npos);
+        std::vector<std::size_t> queue{ source };
+        distances[source] = 0;
+        for (std::size_t head{ 0 }; head < queue.size(); ++head) {
+            const auto node{ queue[head] };
+            for (auto next: graph.out_edges(node)) {
+                if (distances[next] != npos) { continue; }
+                distances[next] = distances[node] + 1;
+                queue.push_back(next);
+            }
+        }
+        return distances;
+    }
+
+    void test_breadth_first_search(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 200 };
+            const auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const compressed_graph compressed{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto expected{ plain_bfs(graph, source) };
+                const auto bfs{ breadth_first_search(
+                    compressed, node_id{ source }, pool) };
+                expect(bfs.distances == expected, "breadth_first_search");
+                for (std::size_t node{ 0 }; node < n; ++node) {
+                    if (expected[node] == 0 || expected[node] == npos) {
+                        continue;
+                    }
+                    const auto parent{ bfs.parents[node] };
+                    expect(expected[parent] + 1 == expected[node] &&
+                               graph.has_edge(node_id{ parent },
+                                              node_id{ node }),
+                           "breadth_first_search parents");
+                }
+            }
+        }
+    }
+
+    // A depth-first search discovers exactly what a BFS reaches, and
+    // finishes a node only after every node discovered from it
+    void test_depth_first_search(std::mt19937& rng) {
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 200 };
+            const auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const auto source{ rng() % n };
+            const auto expected{ plain_bfs(graph, source) };
+            struct visitor {
+                std::vector<std::size_t>& discovered;
+                std::vector<std::size_t>& finished;
+                std::size_t time{ 0 };
+                void discover(std::size_t node) { discovered[node] = time++; }
+                void finish(std::size_t node) { finished[node] = time++; }
+            };
+            std::vector<std::size_t> discovered(n, npos);
+            std::vector<std::size_t> finished(n, npos);
+            depth_first_search(graph, node_id{ source },
+                               visitor{ discovered, finished });
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                const auto reached{ expected[node] != npos };
+                expect((discovered[node] != npos) == reached &&
+                           (finished[node] != npos) == reached,
+                       "depth_first_search reaches what BFS does");
+                if (!reached) { continue; }
+                for (auto to: graph.out_edges(node)) {
+                    expect(finished[to] < finished[node] ||
+                               discovered[to] <= discovered[node],
+                           "depth_first_search finishes descendants first");
+                }
+            }
+        }
+    }
+
+    // Shortest path distances and parents agree with the edges: no edge
+    // leads anywhere more cheaply, and each parent link is an edge on a
+    // shortest path
+    void test_dijkstra(std::mt19937& rng, thread_pool& pool) {
+        dijkstra_search search;
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const compressed_graph compressed{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto result{ dijkstra(graph, node_id{ source }) };
+                const auto& distances{ result.distances };
+                expect(distances[source] == 0 &&
+                           result.parents[source] == source,
+                       "dijkstra source");
+                for (std::size_t node{ 0 }; node < n; ++node) {
+                    for (auto&& edge: graph.out_edges(node)) {
+                        expect(distances[edge.index()] <=
+                                   distances[node] + edge.weight(),
+                               "dijkstra distances are shortest");
+                    }
+                    const auto parent{ result.parents[node] };
+                    if (node == source || distances[node] == infinity) {
+                        expect(distances[node] == 0 || parent == npos,
+                               "dijkstra leaves unreached nodes alone");
+                        continue;
+                    }
+                    const auto weight{ graph.edge_weight(node_id{ parent },
+                                                         node_id{ node }) };
+                    expect(weight &&
+                               distances[parent] + *weight == distances[node],
+                           "dijkstra parents");
+                }
+                expect(dijkstra(compressed, node_id{ source }).distances ==
+                           distances,
+                       "dijkstra over compressed_graph");
+                const auto target{ rng() % n };
+                expect(search.run(graph, node_id{ source },
+                                  node_id{ target }) == distances[target],
+                       "dijkstra_search to a target");
+            }
+        }
+    }
+
+    void test_delta_stepping(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const compressed_graph compressed{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const node_id source{ rng() % n };
+                const auto distances{ dijkstra(graph, source).distances };
+                expect(delta_stepping(graph, source, 0, pool) == distances,
+                       "delta_stepping");
+                expect(delta_stepping(compressed, source, 0.25 + rng() % 8,
+                                      pool) == distances,
+                       "delta_stepping with a given delta");
+            }
+        }
+    }
+
+    // True if path is a path of graph from source to target costing cost
+    bool is_path(const weighted_directed_graph<int>& graph,
+                 const weighted_path& path, std::size_t source,
+                 std::size_t target, double cost) {
+        if (cost == infinity) { return path.nodes.empty(); }
+        if (path.nodes.empty() || path.nodes.front() != source ||
+            path.nodes.back() != target) {
+            return false;
+        }
+        double total{ 0 };
+        for (std::size_t i{ 1 }; i < path.nodes.size(); ++i) {
+            const auto weight{ graph.edge_weight(node_id{ path.nodes[i - 1] },
+                                                 node_id{ path.nodes[i] }) };
+            if (!weight) { return false; }
+            total += *weight;
+        }
+        return total == cost && path.cost == cost;
+    }
+
+    void test_bidirectional_dijkstra(std::mt19937& rng, thread_pool& pool) {
+        bidirectional_dijkstra_search search;
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            for (std::size_t node{ 0 }; node < n; ++node) {
+                std::set<std::size_t> sources;
+                for (std::size_t from{ 0 }; from < n; ++from) {
+                    if (graph.has_edge(node_id{ from }, node_id{ node })) {
+                        sources.insert(from);
+                    }
+                }
+                const auto in_edges{ graph.in_edges(node) };
+                expect(std::ranges::equal(in_edges, sources),
+                       "in_edges mirror out_edges");
+            }
+
+            const compressed_graph compressed{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto distances{
+                    dijkstra(graph, node_id{ source }).distances
+                };
+                for (int query{ 0 }; query < 4; ++query) {
+                    const auto target{ rng() % n };
+                    expect(is_path(graph,
+                                   search.run(compressed, node_id{ source },
+                                              node_id{ target }),
+                                   source, target, distances[target]) &&
+                               is_path(graph,
+                                       bidirectional_dijkstra(
+                                           graph, node_id{ source },
+                                           node_id{ target }),
+                                       source, target, distances[target]),
+                           "bidirectional_dijkstra");
+                }
+            }
+        }
+    }
+
+    void test_astar(std::mt19937& rng, thread_pool& pool) {
+        astar_search search;
+        const auto zero{ [](std::size_t) { return 0.0; } };
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const compressed_graph compressed{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto distances{
+                    dijkstra(graph, node_id{ source }).distances
+                };
+                for (int query{ 0 }; query < 4; ++query) {
+                    const auto target{ rng() % n };
+                    expect(is_path(graph,
+                                   search.run(graph, node_id{ source },
+                                              node_id{ target }, zero),
+                                   source, target, distances[target]) &&
+                               is_path(graph,
+                                       astar(compressed, node_id{ source },
+                                             node_id{ target }, zero),
+                                       source, target, distances[target]),
+                           "astar");
+                }
+            }
+        }
+    }
+
+    void test_contraction_hierarchy(std::mt19937& rng, thread_pool& pool) {
+        contraction_hierarchy_search search;
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const contraction_hierarchy hierarchy{ graph, pool };
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto distances{
+                    dijkstra(graph, node_id{ source }).distances
+                };
+                for (int query{ 0 }; query < 4; ++query) {
+                    const auto target{ rng() % n };
+                    expect(search.distance(hierarchy, node_id{ source },
+                                           node_id{ target }) ==
+                               distances[target],
+                           "contraction_hierarchy distance");
+                    expect(is_path(graph,
+                                   search.path(hierarchy, node_id{ source },
+                                               node_id{ target }),
+                                   source, target, distances[target]),
+                           "contraction_hierarchy path");
+                }
+            }
+        }
+    }
+
+    void test_landmarks(std::mt19937& rng, thread_pool& pool) {
+        astar_search search;
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const compressed_graph compressed{ graph, pool };
+            const auto selection{ round % 2 == 0
+                                      ? alt_landmarks::selection::avoid
+                                      : alt_landmarks::selection::farthest };
+            const alt_landmarks landmarks{ compressed, 1 + rng() % 6,
+                                           selection, pool };
+            std::stringstream saved;
+            expect(landmarks.save(saved), "alt_landmarks::save");
+            const auto loaded{ alt_landmarks::load(saved) };
+            expect(loaded.has_value(), "alt_landmarks::load");
+
+            for (int k{ 0 }; k < 4; ++k) {
+                const auto source{ rng() % n };
+                const auto distances{
+                    dijkstra(graph, node_id{ source }).distances
+                };
+                for (int query{ 0 }; query < 4; ++query) {
+                    const auto target{ rng() % n };
+                    const auto bound{ landmarks.lower_bound(source, target) };
+                    expect(bound <= distances[target] &&
+                               (!loaded ||
+                                loaded->lower_bound(source, target) == bound),
+                           "ALT lower bounds");
+                    expect(is_path(graph,
+                                   search.run(compressed, node_id{ source },
+                                              node_id{ target },
+                                              landmarks.heuristic(
+                                                  node_id{ target })),
+                                   source, target, distances[target]),
+                           "astar with ALT");
+                }
+            }
+        }
+
+        // Damaged files are rejected rather than read
+        const auto graph{ random_weighted_graph(rng, 50, 200, 20) };
+        const compressed_graph compressed{ graph, pool };
+        const alt_landmarks landmarks{ compressed, 3,
+                                       alt_landmarks::selection::avoid, pool };
+        std::stringstream saved;
+        landmarks.save(saved);
+        const auto file{ saved.str() };
+        const auto patched{ [&file](std::size_t offset, std::uint64_t value) {
+            auto copy{ file };
+            copy.replace(offset, sizeof(value),
+                         reinterpret_cast<const char*>(&value), sizeof(value));
+            return copy;
+        } };
+        const auto loads{ [](const std::string& data, bool seekable) {
+            // A stringbuf that can't report or change its position
+            struct unseekable_buffer : std::stringbuf {
+                using std::stringbuf::stringbuf;
+                pos_type seekoff(off_type, std::ios::seekdir,
+                                 std::ios::openmode) override {
+                    return pos_type(off_type(-1));
+                }
+            };
+            unseekable_buffer unseekable{ data };
+            std::stringbuf buffer{ data };
+            std::istream in{ seekable ? static_cast<std::streambuf*>(&buffer)
+                                      : &unseekable };
+            return alt_landmarks::load(in).has_value();
+        } };
+        constexpr std::size_t node_count_at{ 4 };
+        constexpr std::size_t landmark_count_at{ 12 };
+        constexpr std::size_t landmarks_at{ 20 };
+        constexpr std::uint64_t huge{ std::uint64_t{ 1 } << 40 };
+        for (const bool seekable: { true, false }) {
+            expect(loads(file, seekable), "alt_landmarks::load intact");
+            expect(!loads(file.substr(0, file.size() - 1), seekable),
+                   "alt_landmarks::load truncated");
+            expect(!loads(patched(node_count_at, huge), seekable),
+                   "alt_landmarks::load huge node count");
+            expect(!loads(patched(landmark_count_at, huge), seekable),
+                   "alt_landmarks::load too many landmarks");
+            auto overflowing{ patched(node_count_at, ~std::uint64_t{ 0 }) };
+            overflowing.replace(landmark_count_at, sizeof(huge),
+                                reinterpret_cast<const char*>(&huge),
+                                sizeof(huge));
+            expect(!loads(overflowing, seekable),
+                   "alt_landmarks::load overflowing counts");
+            expect(!loads(patched(landmarks_at, graph.size()), seekable),
+                   "alt_landmarks::load bad landmark");
+        }
+    }
+
+    // A graph whose weights run from -8 to 31. With acyclic, edges only
+    // lead from lower to higher nodes, so no cycle can be negative and the
+    // node indices are a topological order.
+    weighted_directed_graph<int> random_negative_graph(std::mt19937& rng,
+                                                       std::size_t n,
+                                                       bool acyclic) {
+        weighted_directed_graph<int> graph;
+        for (std::size_t i{ 0 }; i < n; ++i) {
+            graph.insert(static_cast<int>(i));
+        }
+        const std::size_t m{ rng() % (3 * n) };
+        for (std::size_t k{ 0 }; k < m; ++k) {
+            auto from{ rng() % n };
+            auto to{ rng() % n };
+            if (acyclic) {
+                if (from == to) { continue; }
+                if (from > to) { std::swap(from, to); }
+            }
+            graph.insert_or_assign_edge(
+                node_id{ from }, node_id{ to },
+                static_cast<double>(static_cast<int>(rng() % 40) - 8));
+        }
+        return graph;
+    }
+
+    void test_bellman_ford(std::mt19937& rng, thread_pool& pool) {
+        constexpr bellman_ford_mode modes[]{ bellman_ford_mode::rounds,
+                                             bellman_ford_mode::queue };
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 100 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const node_id source{ rng() % n };
+            const auto distances{ dijkstra(graph, source).distances };
+            for (auto mode: modes) {
+                const auto result{ bellman_ford(graph, source, mode, pool) };
+                expect(result.negative_cycle.empty() &&
+                           result.distances == distances,
+                       "bellman_ford");
+            }
+        }
+
+        for (int round{ 0 }; round < 60; ++round) {
+            const std::size_t n{ 1 + rng() % 60 };
+            const auto acyclic{ round % 2 == 0 };
+            const auto graph{ random_negative_graph(rng, n, acyclic) };
+            for (auto mode: modes) {
+                const auto cycle{ find_negative_cycle(graph, mode, pool) };
+                double total{ 0 };
+                for (std::size_t i{ 0 }; i < cycle.size(); ++i) {
+                    const auto weight{ graph.edge_weight(
+                        node_id{ cycle[i] },
+                        node_id{ cycle[(i + 1) % cycle.size()] }) };
+                    expect(weight.has_value(), "negative cycle edges exist");
+                    total += weight.value_or(0);
+                }
+                expect(cycle.empty() || (total < 0 && !acyclic),
+                       "negative cycle has a negative weight");
+            }
+            if (!acyclic) { continue; }
+
+            const auto source{ rng() % n };
+            std::vector<double> expected(n, infinity);
+            expected[source] = 0;
+            for (auto node{ source }; node < n; ++node) {
+                if (expected[node] == infinity) { continue; }
+                for (auto&& edge: graph.out_edges(node)) {
+                    auto& distance{ expected[edge.index()] };
+                    distance = std::min(distance,
+                                        expected[node] + edge.weight());
+                }
+            }
+            for (auto mode: modes) {
+                expect(bellman_ford(graph, node_id{ source }, mode, pool)
+                               .distances == expected,
+                       "bellman_ford with negative weights");
+            }
+        }
+    }
+
+    void test_floyd_warshall(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 120 };
+            const auto graph{ random_weighted_graph(rng, n, rng() % (4 * n),
+                                                    1 + rng() % 100) };
+            const auto matrix{ floyd_warshall(graph, true, pool) };
+            for (std::size_t source{ 0 }; source < n; ++source) {
+                const auto distances{
+                    dijkstra(graph, node_id{ source }).distances
+                };
+                expect(std::ranges::equal(distances, matrix.row(source)),
+                       "floyd_warshall");
+                const auto target{ rng() % n };
+                const auto path{ matrix.path(source, target) };
+                const auto distance{ distances[target] };
+                expect(distance == infinity
+                           ? path.empty()
+                           : is_path(graph, { path, distance }, source, target,
+                                     distance),
+                       "floyd_warshall path");
+            }
+        }
+
+        for (int round{ 0 }; round < 60; ++round) {
+            const std::size_t n{ 1 + rng() % 60 };
+            const auto graph{ random_negative_graph(rng, n, round % 2 == 0) };
+            const auto matrix{ floyd_warshall(graph, false, pool) };
+            expect(matrix.has_negative_cycle() ==
+                       !find_negative_cycle(graph).empty(),
+                   "floyd_warshall finds negative cycles");
+            if (matrix.has_negative_cycle()) { continue; }
+            for (std::size_t source{ 0 }; source < n; ++source) {
+                expect(std::ranges::equal(
+                           bellman_ford(graph, node_id{ source }).distances,
+                           matrix.row(source)),
+                       "floyd_warshall with negative weights");
+            }
+        }
+    }
+
+    void test_johnson(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 80; ++round) {
+            const std::size_t n{ 1 + rng() % 60 };
+            const auto graph{ round % 4 == 0
+                                  ? random_weighted_graph(rng, n,
+                                                          rng() % (4 * n), 50)
+                                  : random_negative_graph(rng, n,
+                                                          round % 2 == 0) };
+            const auto matrix{ floyd_warshall(graph, false, pool) };
+            std::vector<std::vector<double>> rows(n);
+            const auto accepted{ johnson(
+                graph,
+                [&](std::size_t source, std::span<const double> distances) {
+                    rows[source].assign(std::begin(distances),
+                                        std::end(distances));
+                },
+                pool) };
+            expect(accepted != matrix.has_negative_cycle(),
+                   "johnson rejects negative cycles");
+            if (!accepted) { continue; }
+            for (std::size_t source{ 0 }; source < n; ++source) {
+                expect(std::ranges::equal(rows[source], matrix.row(source)),
+                       "johnson");
+            }
+        }
+
+        // A source that isn't a node is rejected before any search is run
+        const auto graph{ random_weighted_graph(rng, 20, 60, 50) };
+        const std::vector<std::size_t> sources{ 3, graph.size(), 7 };
+        std::size_t calls{ 0 };
+        expect(!johnson(
+                   graph, std::span<const std::size_t>{ sources },
+                   [&calls](std::size_t, std::span<const double>) { ++calls; },
+                   pool) &&
+                   calls == 0,
+               "johnson rejects sources out of range");
+    }
+
+    void test_multi_source_bfs(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 40; ++round) {
+            const std::size_t n{ 1 + rng() % 200 };
+            const auto graph{ random_graph(rng, n, rng() % (3 * n)) };
+            const compressed_graph compressed{ graph, pool };
+            std::vector<std::size_t> sources;
+            const std::size_t count{ 1 + rng() % 80 };
+            for (std::size_t k{ 0 }; k < count; ++k) {
+                sources.push_back(rng() % n);
+            }
+            // A node may be listed as more than one source
+            sources.push_back(sources.front());
+            const auto levels{ multi_source_bfs(
+                compressed, std::span<const std::size_t>{ sources }, pool) };
+            const auto reachable{ multi_source_reachability(
+                compressed, std::span<const std::size_t>{ sources }, pool) };
+            for (std::size_t i{ 0 }; i < sources.size(); ++i) {
+                const auto expected{ plain_bfs(graph, sources[i]) };
+                expect(levels[i] == expected, "multi_source_bfs");
+                for (std::size_t node{ 0 }; node < n; ++node) {
+                    expect(reachable[i][node] == (expected[node] != npos),
+                           "multi_source_reachability");
+                }
+            }
+        }
+    }
+
+    // True if order lists every node once, with every edge leading forward
+    bool is_topological(const directed_graph<int>& graph,
+                        const std::vector<std::size_t>& order) {
+        if (order.size() != graph.size()) { return false; }
+        std::vector<std::size_t> positions(graph.size(), npos);
+        for (std::size_t i{ 0 }; i < order.size(); ++i) {
+            if (order[i] >= graph.size() || positions[order[i]] != npos) {
+                return false;
+            }
+            positions[order[i]] = i;
+        }
+        for (std::size_t node{ 0 }; node < graph.size(); ++node) {
+            for (auto to: graph.out_edges(node)) {
+                if (positions[node] >= positions[to]) { return false; }
+            }
+        }
+        return true;
+    }
+
+    void test_topological_sort(std::mt19937& rng, thread_pool& pool) {
+        for (int round{ 0 }; round < 60; ++round) {
+            const std::size_t n{ 1 + rng() % 100 };
+            const auto graph{ random_graph(rng, n, rng() % (2 * n),
+                                           round % 2 == 0) };
+            const auto cyclic{ has_cycle(graph) };
+
+            const auto order{ topological_sort(graph) };
+            expect(order.has_value() != cyclic, "topological_sort on cycles");
+            if (order) {
+                expect(is_topological(graph, *order), "topological_sort");
+            }
+
+            const auto levels{ topological_levels(graph, pool) };
+            expect(levels.has_value() != cyclic,
+                   "topological_levels on cycles");
+            if (levels) {
+                std::vector<std::size_t> concatenated;
+                for (auto&& level: *levels) {
+                    concatenated.insert(std::end(concatenated),
+                                        std::begin(level), std::end(level));
+                }
+                expect(is_topological(graph, concatenated),
+                       "topological_levels");
+            }
+        }
+
+        // Edges accepted by the incremental order are exactly those that
+        // keep the graph acyclic
+        for (int round{ 0 }; round < 20; ++round) {
+            const std::size_t n{ 1 + rng() % 40 };
+            directed_graph<int> graph;
+            incremental_topological_order order;
+            for (std::size_t i{ 0 }; i < n; ++i) {
+                graph.insert(static_cast<int>(i));
+                order.insert_node();
+            }
+            for (int k{ 0 }; k < 150; ++k) {
+                const node_id from{ rng() % n };
+                const node_id to{ rng() % n };
+                if (rng() % 4 == 0) {
+                    expect(order.erase_edge(from, to) ==
+                               graph.erase_edge(from, to),
+                           "incremental erase_edge");
+                    continue;
+                }
+                const auto inserted{ graph.insert_edge(from, to) };
+                const auto acceptable{ !has_cycle(graph) };
+                expect(order.insert_edge(from, to) == acceptable,
+                       "incremental insert_edge agrees with has_cycle");
+                if (inserted && !acceptable) { graph.erase_edge(from, to); }
+                const std::vector<std::size_t> nodes(
+                    std::begin(order.order()), std::end(order.order()));
+                expect(is_topological(graph, nodes), "incremental order");
+            }
+            expect(!order.insert_edge(node_id{ n }, node_id{ 0 }),
+                   "incremental order rejects unknown nodes");
+        }
+
+        // An order built from a graph finds the graph's edges again
+        for (int round{ 0 }; round < 20; ++round) {
+            const std::size_t n{ 2 + rng() % 40 };
+            auto graph{ random_graph(rng, n, rng() % (3 * n), true) };
+            auto order{ *incremental_topological_order::from_graph(graph) };
+            for (int k{ 0 }; k < 60; ++k) {
+                const node_id from{ rng() % n };
+                const node_id to{ rng() % n };
+                const auto existing{ graph.has_edge(from, to) };
+                if (existing && rng() % 2 == 0) {
+                    expect(order.erase_edge(from, to) &&
+                               graph.erase_edge(from, to),
+                           "incremental erase_edge after from_graph");
+                    continue;
+                }
+                const auto inserted{ graph.insert_edge(from, to) };
+                const auto acceptable{ !has_cycle(graph) };
+                expect(order.insert_edge(from, to) == acceptable,
+                       "incremental insert_edge after from_graph");
+                if (inserted && !acceptable) { graph.erase_edge(from, to); }
+                const std::vector<std::size_t> nodes(
+                    std::begin(order.order()), std::end(order.order()));
+                expect(is_topological(graph, nodes),
+                       "incremental order after from_graph");
+            }
+        }
+    }
+}// namespace
+
+int main() {
+    // More workers than this machine may have cores, so that the parallel
+    // paths are taken everywhere
+    thread_pool pool{ 4 };
+    std::mt19937 rng{ 2024 };
+
+    test_adjacency_views(rng);
+    test_weighted_edge_views(rng);
+    test_index_api(rng);
+    test_equality(rng);
+    test_fingerprint(rng);
+    test_versioned_graph(rng);
+    test_concurrent_graph(rng, pool);
+    test_builder(rng, pool);
+    test_batch(rng, pool);
+    test_weight_updates(rng);
+    test_edge_lookup(rng);
+    test_degrees(rng, pool);
+    test_compressed_graph(rng, pool);
+    test_breadth_first_search(rng, pool);
+    test_depth_first_search(rng);
+    test_dijkstra(rng, pool);
+    test_delta_stepping(rng, pool);
+    test_bidirectional_dijkstra(rng, pool);
+    test_astar(rng, pool);
+    test_contraction_hierarchy(rng, pool);
+    test_landmarks(rng, pool);
+    test_bellman_ford(rng, pool);
+    test_floyd_warshall(rng, pool);
+    test_johnson(rng, pool);
+    test_multi_source_bfs(rng, pool);
+    test_topological_sort(rng, pool);
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "All checks passed\n";
+    return 0;
+}
@@ -0,0 +1,179 @@
+//
+// A small fixed-size thread pool for the parallel graph algorithms.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Runs data-parallel jobs on a fixed set of threads. The thread that calls
+// run() or parallel_for() takes part in the job as worker 0, so a pool of
+// size 1 does everything on the calling thread. Jobs from different
+// threads are run one after the other. Jobs must not start another job on
+// the same pool.
+class thread_pool {
+public:
+    // A pool of thread_count workers, including the calling thread
+    explicit thread_pool(
+        std::size_t thread_count = std::thread::hardware_concurrency());
+
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    // Calls job(worker) once on each worker, with worker in [0, size()), and
+    // returns when all calls have finished. If any call throws, the first
+    // exception is rethrown here.
+    void run(const std::function<void(std::size_t)>& job);
+
+    // Calls fn(i) for each i in [first, last). Workers take chunks of
+    // `grain` consecutive indices at a time.
+    template<typename F>
+    void parallel_for(std::size_t first, std::size_t last, F&& fn,
+                      std::size_t grain = 1024);
+
+    // Calls fn(worker, chunk_first, chunk_last) for chunks of [first, last),
+    // for loops that keep per-worker state
+    template<typename F>
+    void parallel_for_chunks(std::size_t first, std::size_t last, F&& fn,
+                             std::size_t grain = 1024);
+
+private:
+    std::vector<std::jthread> m_threads;
+
+    // Serialises calls to run() from different threads
+    std::mutex m_runMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void(std::size_t)>* m_job{ nullptr };
+    std::size_t m_generation{ 0 };
+    std::size_t m_pending{ 0 };
+    std::exception_ptr m_error;
+    bool m_stopping{ false };
+
+    void worker_loop(std::size_t worker);
+
+    void run_job(const std::function<void(std::size_t)>& job,
+                 std::size_t worker) noexcept;
+};
+
+// A pool sized to the machine, for callers that don't manage their own
+inline thread_pool& default_thread_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+inline thread_pool::thread_pool(std::size_t thread_count) {
+    thread_count = std::max<std::size_t>(thread_count, 1);
+    m_threads.reserve(thread_count - 1);
+    for (std::size_t worker{ 1 }; worker < thread_count; ++worker) {
+        m_threads.emplace_back([this, worker] { worker_loop(worker); });
+    }
+}
+
+inline thread_pool::~thread_pool() {
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    // Join before the mutex and condition variables go away
+    m_threads.clear();
+}
+
+inline std::size_t thread_pool::size() const noexcept {
+    return m_threads.size() + 1;
+}
+
+inline void thread_pool::run(const std::function<void(std::size_t)>& job) {
+    std::scoped_lock run_lock{ m_runMutex };
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_job = &job;
+        m_pending = m_threads.size();
+        m_error = nullptr;
+        ++m_generation;
+    }
+    m_wake.notify_all();
+    run_job(job, 0);
+
+    std::unique_lock lock{ m_mutex };
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_job = nullptr;
+    if (m_error) { std::rethrow_exception(std::exchange(m_error, nullptr)); }
+}
+
+inline void thread_pool::run_job(const std::function<void(std::size_t)>& job,
+                                 std::size_t worker) noexcept {
+    try {
+        job(worker);
+    } catch (...) {
+        std::scoped_lock lock{ m_mutex };
+        if (!m_error) { m_error = std::current_exception(); }
+    }
+}
+
+inline void thread_pool::worker_loop(std::size_t worker) {
+    std::size_t seen{ 0 };
+    while (true) {
+        const std::function<void(std::size_t)>* job{ nullptr };
+        {
+            std::unique_lock lock{ m_mutex };
+            m_wake.wait(lock, [this, seen] {
+                return m_stopping || m_generation != seen;
+            });
+            if (m_stopping) { return; }
+            seen = m_generation;
+            job = m_job;
+        }
+        run_job(*job, worker);
+        // Notify under the lock, as run() may return, and the pool be
+        // destroyed, as soon as it sees m_pending reach zero
+        std::scoped_lock lock{ m_mutex };
+        if (--m_pending == 0) { m_done.notify_one(); }
+    }
+}
+
+template<typename F>
+void thread_pool::parallel_for(std::size_t first, std::size_t last, F&& fn,
+                               std::size_t grain) {
+    parallel_for_chunks(
+        first, last,
+        [&fn](std::size_t, std::size_t chunk_first, std::size_t chunk_last) {
+            for (auto i{ chunk_first }; i < chunk_last; ++i) { fn(i); }
+        },
+        grain);
+}
+
+template<typename F>
+void thread_pool::parallel_for_chunks(std::size_t first, std::size_t last,
+                                      F&& fn, std::size_t grain) {
+    if (first >= last) { return; }
+    grain = std::max<std::size_t>(grain, 1);
+    // Small ranges aren't worth waking the workers for
+    if (last - first <= grain || size() == 1) {
+        fn(std::size_t{ 0 }, first, last);
+        return;
+    }
+    std::atomic<std::size_t> next{ first };
+    run([&](std::size_t worker) {
+        while (true) {
+            const auto chunk_first{ next.fetch_add(grain) };
+            if (chunk_first >= last) { return; }
+            fn(worker, chunk_first, std::min(chunk_first + grain, last));
+        }
+    });
+}
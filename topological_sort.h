@@ -0,0 +1,338 @@
+//
+// Topological orders of directed acyclic graphs, from scratch and kept up
+// to date as edges are added.
+//
+#pragma once
+
+#include "graph_common.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// The node indices of graph, a directed_graph, weighted_directed_graph or
+// compressed_graph, in an order where every edge leads from an earlier
+// node to a later one, or nothing if the graph has a cycle. Uses Kahn's
+// algorithm: nodes are output once all the edges into them have been
+// accounted for, with in-degrees counted in a flat array up front.
+template<typename Graph>
+[[nodiscard]] std::optional<std::vector<std::size_t>>
+topological_sort(const Graph& graph);
+
+// The nodes of graph split into levels, or nothing if it has a cycle. The
+// first level holds the nodes with no edges into them, and each later one
+// the nodes whose edges in all come from earlier levels, so the nodes of a
+// level don't depend on each other and, for a task graph, can be run at
+// the same time. Each level is in ascending order, and concatenating them
+// gives a topological order.
+//
+// This is Kahn's algorithm a level at a time, with the edges out of each
+// level followed in parallel on pool and in-degrees counted down
+// atomically.
+template<typename Graph>
+[[nodiscard]] std::optional<std::vector<std::vector<std::size_t>>>
+topological_levels(const Graph& graph,
+                   thread_pool& pool = default_thread_pool());
+
+// A topological order of a graph's nodes that is repaired as edges are
+// added, rather than recomputed, by the algorithm of Pearce and Kelly. An
+// edge that already agrees with the order costs nothing. Otherwise, only
+// the nodes whose positions lie between the edge's ends are searched: those
+// reachable from its target, and those that reach its source, which then
+// swap into each other's positions. An edge that would close a cycle is
+// found by the same search and rejected.
+//
+// The order keeps its own copy of the edges, in both directions, so it
+// works with any graph type. It is only kept valid if every change to the
+// graph's nodes and edges is also made here, and edges are only inserted
+// into the graph once insert_edge() has accepted them. Erasing nodes from
+// the graph renumbers them, so the order must be rebuilt after that.
+class incremental_topological_order {
+public:
+    using size_type = std::size_t;
+
+    incremental_topological_order() = default;
+
+    // An order for graph, or nothing if it has a cycle
+    template<typename Graph>
+    [[nodiscard]] static std::optional<incremental_topological_order>
+    from_graph(const Graph& graph);
+
+    [[nodiscard]] size_type size() const noexcept;
+
+    // The nodes, first to last
+    [[nodiscard]] std::span<const size_type> order() const noexcept;
+
+    // Where node is in the order
+    [[nodiscard]] size_type position(size_type node) const;
+
+    // Adds a node, with the next index, at the end of the order
+    size_type insert_node();
+
+    // Adds an edge from `from` to `to` and repairs the order, or returns
+    // false and leaves everything unchanged if the edge would close a cycle
+    // or either node is out of range. Inserting an edge that is already
+    // here changes nothing and returns true.
+    bool insert_edge(node_id from, node_id to);
+
+    // Removes an edge, which never invalidates the order. Returns false if
+    // there is no such edge, or either node is out of range.
+    bool erase_edge(node_id from, node_id to);
+
+private:
+    // Nodes in order, and the position of each node in m_order
+    std::vector<size_type> m_order;
+    std::vector<size_type> m_positions;
+    // Each node's edges out and in, by the node at the other end. The lists
+    // are kept sorted so that an edge is found by a binary search, however
+    // many edges its node has.
+    std::vector<std::vector<size_type>> m_outEdges;
+    std::vector<std::vector<size_type>> m_inEdges;
+
+    // Scratch for insert_edge, kept between calls: marks for the nodes
+    // each search has reached, the search stack, the nodes found forwards
+    // and backwards, and the positions they take
+    std::vector<char> m_visited;
+    std::vector<size_type> m_stack;
+    std::vector<size_type> m_forward;
+    std::vector<size_type> m_backward;
+    std::vector<size_type> m_slots;
+
+    // Collects in found the nodes reachable from start, along out-edges
+    // if Forward or in-edges otherwise, that lie strictly between start and
+    // the bound in the order. Returns false, as soon as it is reached, if
+    // the node at the bound can be reached.
+    template<bool Forward>
+    bool search(size_type start, size_type bound,
+                std::vector<size_type>& found);
+};
+
+template<typename Graph>
+std::optional<std::vector<std::size_t>> topological_sort(const Graph& graph) {
+    using size_type = std::size_t;
+    const auto n{ graph.size() };
+    std::vector<size_type> in_degrees(n, 0);
+    for (size_type node{ 0 }; node < n; ++node) {
+        for (auto&& edge: graph.out_edges(node)) {
+            ++in_degrees[details::edge_target(edge)];
+        }
+    }
+
+    // The order doubles as the queue of nodes ready to output
+    std::vector<size_type> order;
+    order.reserve(n);
+    for (size_type node{ 0 }; node < n; ++node) {
+        if (in_degrees[node] == 0) { order.push_back(node); }
+    }
+    for (size_type i{ 0 }; i < order.size(); ++i) {
+        for (auto&& edge: graph.out_edges(order[i])) {
+            const auto to{ details::edge_target(edge) };
+            if (--in_degrees[to] == 0) { order.push_back(to); }
+        }
+    }
+    if (order.size() != n) { return {}; }
+    return order;
+}
+
+template<typename Graph>
+std::optional<std::vector<std::vector<std::size_t>>>
+topological_levels(const Graph& graph, thread_pool& pool) {
+    using size_type = std::size_t;
+    const auto n{ graph.size() };
+    std::vector<size_type> in_degrees(n, 0);
+    pool.parallel_for(
+        0, n,
+        [&](size_type node) {
+            for (auto&& edge: graph.out_edges(node)) {
+                std::atomic_ref{ in_degrees[details::edge_target(edge)] }
+                    .fetch_add(1, std::memory_order_relaxed);
+            }
+        },
+        256);
+
+    std::vector<std::vector<size_type>> levels(1);
+    for (size_type node{ 0 }; node < n; ++node) {
+        if (in_degrees[node] == 0) { levels[0].push_back(node); }
+    }
+    size_type ordered{ levels[0].size() };
+    std::vector<std::vector<size_type>> next(pool.size());
+    while (!levels.back().empty()) {
+        const auto& level{ levels.back() };
+        pool.parallel_for_chunks(
+            0, level.size(),
+            [&](size_type worker, size_type first, size_type last) {
+                for (auto i{ first }; i < last; ++i) {
+                    for (auto&& edge: graph.out_edges(level[i])) {
+                        const auto to{ details::edge_target(edge) };
+                        // Whoever removes the last edge in owns the node
+                        if (std::atomic_ref{ in_degrees[to] }.fetch_sub(
+                                1, std::memory_order_relaxed) == 1) {
+                            next[worker].push_back(to);
+                        }
+                    }
+                }
+            },
+            64);
+        std::vector<size_type> next_level;
+        for (auto& nodes: next) {
+            next_level.insert(std::end(next_level), std::begin(nodes),
+                              std::end(nodes));
+            nodes.clear();
+        }
+        std::sort(std::begin(next_level), std::end(next_level));
+        ordered += next_level.size();
+        levels.push_back(std::move(next_level));
+    }
+    levels.pop_back();
+    if (ordered != n) { return {}; }
+    return levels;
+}
+
+template<typename Graph>
+std::optional<incremental_topological_order>
+incremental_topological_order::from_graph(const Graph& graph) {
+    auto sorted{ topological_sort(graph) };
+    if (!sorted) { return {}; }
+
+    const auto n{ graph.size() };
+    incremental_topological_order result;
+    result.m_order = std::move(*sorted);
+    result.m_positions.resize(n);
+    for (size_type i{ 0 }; i < n; ++i) {
+        result.m_positions[result.m_order[i]] = i;
+    }
+    result.m_outEdges.resize(n);
+    result.m_inEdges.resize(n);
+    for (size_type node{ 0 }; node < n; ++node) {
+        for (auto&& edge: graph.out_edges(node)) {
+            const auto to{ details::edge_target(edge) };
+            result.m_outEdges[node].push_back(to);
+            result.m_inEdges[to].push_back(node);
+        }
+        // The in-edge lists come out sorted, as nodes are taken in order
+        std::sort(std::begin(result.m_outEdges[node]),
+                  std::end(result.m_outEdges[node]));
+    }
+    result.m_visited.assign(n, 0);
+    return result;
+}
+
+inline incremental_topological_order::size_type
+incremental_topological_order::size() const noexcept {
+    return m_order.size();
+}
+
+inline std::span<const incremental_topological_order::size_type>
+incremental_topological_order::order() const noexcept {
+    return m_order;
+}
+
+inline incremental_topological_order::size_type
+incremental_topological_order::position(size_type node) const {
+    return m_positions[node];
+}
+
+inline incremental_topological_order::size_type
+incremental_topological_order::insert_node() {
+    const auto node{ m_order.size() };
+    m_order.push_back(node);
+    m_positions.push_back(node);
+    m_outEdges.emplace_back();
+    m_inEdges.emplace_back();
+    m_visited.push_back(0);
+    return node;
+}
+
+inline bool incremental_topological_order::insert_edge(node_id from,
+                                                       node_id to) {
+    if (from.index >= size() || to.index >= size() ||
+        from.index == to.index) {
+        return false;
+    }
+    // An edge that is already here is already respected by the order
+    auto& out{ m_outEdges[from.index] };
+    const auto out_edge{ std::lower_bound(std::begin(out), std::end(out),
+                                          to.index) };
+    if (out_edge != std::end(out) && *out_edge == to.index) { return true; }
+    const auto lower{ m_positions[to.index] };
+    const auto upper{ m_positions[from.index] };
+    if (lower < upper) {
+        // Everything that must move lies in [lower, upper]: what to
+        // reaches, which has to go after from, and what reaches from
+        m_forward.clear();
+        m_backward.clear();
+        const auto acyclic{ search<true>(to.index, upper, m_forward) };
+        if (acyclic) { search<false>(from.index, lower, m_backward); }
+        for (auto node: m_forward) { m_visited[node] = 0; }
+        for (auto node: m_backward) { m_visited[node] = 0; }
+        if (!acyclic) { return false; }
+
+        // The two sets give up their positions, and take them back with
+        // the backward set first, each keeping its own relative order
+        const auto by_position{ [this](size_type a, size_type b) {
+            return m_positions[a] < m_positions[b];
+        } };
+        std::sort(std::begin(m_forward), std::end(m_forward), by_position);
+        std::sort(std::begin(m_backward), std::end(m_backward), by_position);
+        m_slots.clear();
+        for (auto node: m_backward) { m_slots.push_back(m_positions[node]); }
+        for (auto node: m_forward) { m_slots.push_back(m_positions[node]); }
+        std::sort(std::begin(m_slots), std::end(m_slots));
+        auto slot{ std::begin(m_slots) };
+        for (auto* nodes: { &m_backward, &m_forward }) {
+            for (auto node: *nodes) {
+                m_positions[node] = *slot;
+                m_order[*slot] = node;
+                ++slot;
+            }
+        }
+    }
+    // Neither list has changed since out_edge was found
+    out.insert(out_edge, to.index);
+    auto& in{ m_inEdges[to.index] };
+    in.insert(std::lower_bound(std::begin(in), std::end(in), from.index),
+              from.index);
+    return true;
+}
+
+inline bool incremental_topological_order::erase_edge(node_id from,
+                                                      node_id to) {
+    if (from.index >= size() || to.index >= size()) { return false; }
+    auto& out{ m_outEdges[from.index] };
+    const auto out_edge{ std::lower_bound(std::begin(out), std::end(out),
+                                          to.index) };
+    if (out_edge == std::end(out) || *out_edge != to.index) { return false; }
+    out.erase(out_edge);
+    auto& in{ m_inEdges[to.index] };
+    in.erase(std::lower_bound(std::begin(in), std::end(in), from.index));
+    return true;
+}
+
+template<bool Forward>
+bool incremental_topological_order::search(size_type start, size_type bound,
+                                           std::vector<size_type>& found) {
+    m_stack.clear();
+    m_stack.push_back(start);
+    m_visited[start] = 1;
+    found.push_back(start);
+    while (!m_stack.empty()) {
+        const auto node{ m_stack.back() };
+        m_stack.pop_back();
+        for (auto next: Forward ? m_outEdges[node] : m_inEdges[node]) {
+            const auto position{ m_positions[next] };
+            if (position == bound) { return false; }
+            const auto between{ Forward ? position < bound
+                                        : position > bound };
+            if (!between || m_visited[next]) { continue; }
+            m_visited[next] = 1;
+            found.push_back(next);
+            m_stack.push_back(next);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,618 @@
+//
+// A directed graph with copy-on-write snapshots, for one writer thread and
+// any number of reader threads.
+//
+#pragma once
+
+#include "directed_graph.h"
+#include "graph_common.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+template<typename T>
+class versioned_directed_graph;
+
+namespace details {
+    // A fixed-size run of consecutive node slots. Blocks are shared between
+    // every version that hasn't modified any of their nodes, and are copied
+    // by the writer before it changes them.
+    template<typename T>
+    struct snapshot_block {
+        std::vector<T> values;
+        std::vector<std::uint64_t> hashes;
+        // Sorted target indices of each node's out-edges
+        std::vector<std::vector<size_t>> adjacency;
+        // Sorted source indices of each node's in-edges, so that erasing a
+        // node only touches the blocks of its neighbours
+        std::vector<std::vector<size_t>> in_adjacency;
+        // Zero for the slots of erased nodes
+        std::vector<char> live;
+        // The writer generation that owns this block. Blocks from an older
+        // generation may be visible to readers and must not be modified.
+        std::uint64_t generation{ 0 };
+    };
+
+    // An immutable, published state of a versioned_directed_graph
+    template<typename T>
+    struct snapshot_version {
+        std::vector<std::shared_ptr<const snapshot_block<T>>> blocks;
+        size_t size{ 0 };
+        size_t slot_count{ 0 };
+        std::uint64_t fingerprint{ 0 };
+        // Node hash to index, built from the cached hashes by the first
+        // lookup through any snapshot of this version
+        mutable std::once_flag value_index_built;
+        mutable value_index_type<T> value_index;
+    };
+}// namespace details
+
+// A read-only view of a versioned_directed_graph as of one commit. Taking
+// and reading a snapshot never blocks, and later changes to the graph are
+// never seen through it. Node indices are as in the graph, and may include
+// the slots of erased nodes.
+template<typename T>
+class directed_graph_snapshot {
+public:
+    using value_type = T;
+    using const_reference = const T&;
+    using size_type = size_t;
+    using const_iterator_adjacent_indices =
+        std::vector<size_t>::const_iterator;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    // An empty graph
+    directed_graph_snapshot();
+
+    // Number of nodes, not counting erased ones
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    // One past the highest node index
+    [[nodiscard]] size_type slot_count() const noexcept;
+
+    // True if index holds a node, rather than the slot of an erased one
+    [[nodiscard]] bool contains(size_type index) const;
+
+    [[nodiscard]] std::uint64_t fingerprint() const noexcept;
+
+    // Returns the value of the node at index. No bounds checking.
+    [[nodiscard]] const_reference value(size_type index) const;
+
+    const_reference operator[](size_type index) const;
+
+    // View over the indices of the nodes connected to the node at index, in
+    // ascending order, which is empty for an erased node. No bounds
+    // checking.
+    [[nodiscard]] iterator_range<const_iterator_adjacent_indices>
+    out_edges(size_type index) const;
+
+    // Returns the index of the node with node_value, or npos if there is no
+    // such node. For a hashable T, the first lookup in a version indexes
+    // its nodes by their cached hashes, and later ones take O(1); otherwise
+    // this is a linear search.
+    [[nodiscard]] size_type index_of(const T& node_value) const;
+
+private:
+    friend class versioned_directed_graph<T>;
+
+    using version_type = details::snapshot_version<T>;
+
+    explicit directed_graph_snapshot(
+        std::shared_ptr<const version_type> version);
+
+    std::shared_ptr<const version_type> m_version;
+};
+
+// A directed graph whose state is published in versions. All modifications
+// must come from a single writer thread, and become visible to snapshot()
+// once the writer calls commit(). Any thread may call snapshot() at any
+// time. Snapshots share all unmodified nodes with the graph, so committing
+// costs one pointer per block of nodes plus a copy of each block changed
+// since the last commit.
+//
+// Unlike in directed_graph, erasing a node leaves its index unused rather
+// than shifting the later nodes down, so that only the blocks of the node
+// and its neighbours are copied. The next insert() reuses the slot, and
+// compact() renumbers the nodes to close all the gaps at once.
+template<typename T>
+class versioned_directed_graph {
+public:
+    using value_type = T;
+    using const_reference = const T&;
+    using size_type = size_t;
+    using snapshot_type = directed_graph_snapshot<T>;
+
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
+
+    // Number of nodes in each copy-on-write block
+    static constexpr size_type block_size{ 256 };
+
+    versioned_directed_graph();
+
+    // Starts from the nodes and edges of graph, published as the first
+    // version
+    template<typename A>
+    explicit versioned_directed_graph(const directed_graph<T, A>& graph);
+
+    // Not copyable, as readers hold on to the published state
+    versioned_directed_graph(const versioned_directed_graph&) = delete;
+    versioned_directed_graph&
+    operator=(const versioned_directed_graph&) = delete;
+
+    // Returns the most recently committed version. Safe to call from any
+    // thread, concurrently with the writer.
+    [[nodiscard]] snapshot_type snapshot() const;
+
+    // Publishes all modifications made since the last commit
+    void commit();
+
+    // The remaining members are for the writer thread only, and see
+    // uncommitted changes.
+
+    // Returns true if the node is inserted, or false if it was already
+    // present
+    bool insert(const T& node_value);
+
+    // Returns true if the given node is erased. Other nodes keep their
+    // indices.
+    bool erase(const T& node_value);
+
+    // Renumbers the nodes to close the gaps left by erased ones, keeping
+    // their order, as erasing them from a directed_graph would. This
+    // rewrites every block.
+    void compact();
+
+    // Returns true if the edge was inserted successfully
+    bool insert_edge(const T& from_node_value, const T& to_node_value);
+
+    bool insert_edge(node_id from, node_id to);
+
+    // Returns true if the edge is removed successfully
+    bool erase_edge(const T& from_node_value, const T& to_node_value);
+
+    bool erase_edge(node_id from, node_id to);
+
+    // Number of nodes, not counting erased ones
+    [[nodiscard]] size_type size() const noexcept;
+
+    [[nodiscard]] bool empty() const noexcept;
+
+    // One past the highest node index
+    [[nodiscard]] size_type slot_count() const noexcept;
+
+    // True if index holds a node, rather than the slot of an erased one
+    [[nodiscard]] bool contains(size_type index) const;
+
+    // Returns the index of the node with node_value, or npos if there is no
+    // such node
+    [[nodiscard]] size_type index_of(const T& node_value) const;
+
+private:
+    using block_type = details::snapshot_block<T>;
+    using version_type = details::snapshot_version<T>;
+
+    // The writer's working copy of the blocks
+    std::vector<std::shared_ptr<block_type>> m_blocks;
+    size_type m_size{ 0 };
+    size_type m_slotCount{ 0 };
+    // Slots of erased nodes, for insert() to reuse
+    std::vector<size_type> m_freeSlots;
+    std::uint64_t m_fingerprint{ 0 };
+    std::uint64_t m_generation{ 1 };
+
+    // Value to index lookup for the writer. Uses std::hash when T has it,
+    // and a linear search otherwise.
+    std::conditional_t<details::hashable<T>,
+                       std::unordered_map<T, size_type>, std::monostate>
+        m_indices;
+
+    std::atomic<std::shared_ptr<const version_type>> m_published;
+
+    // Returns the block holding node index, copying it first if it may be
+    // shared with a published version
+    block_type& mutable_block(size_type index);
+
+    [[nodiscard]] const block_type& block(size_type index) const;
+
+    [[nodiscard]] std::uint64_t node_hash(size_type index) const;
+
+    [[nodiscard]] std::vector<size_t>& mutable_adjacency(size_type index);
+
+    [[nodiscard]] std::vector<size_t>&
+    mutable_in_adjacency(size_type index);
+};
+
+template<typename T>
+directed_graph_snapshot<T>::directed_graph_snapshot()
+    : m_version{ std::make_shared<const version_type>() } {}
+
+template<typename T>
+directed_graph_snapshot<T>::directed_graph_snapshot(
+    std::shared_ptr<const version_type> version)
+    : m_version{ std::move(version) } {}
+
+template<typename T>
+typename directed_graph_snapshot<T>::size_type
+directed_graph_snapshot<T>::size() const noexcept {
+    return m_version->size;
+}
+
+template<typename T>
+bool directed_graph_snapshot<T>::empty() const noexcept {
+    return m_version->size == 0;
+}
+
+template<typename T>
+typename directed_graph_snapshot<T>::size_type
+directed_graph_snapshot<T>::slot_count() const noexcept {
+    return m_version->slot_count;
+}
+
+template<typename T>
+bool directed_graph_snapshot<T>::contains(size_type index) const {
+    constexpr auto block_size{ versioned_directed_graph<T>::block_size };
+    return index < slot_count() &&
+           m_version->blocks[index / block_size]->live[index % block_size];
+}
+
+template<typename T>
+std::uint64_t directed_graph_snapshot<T>::fingerprint() const noexcept {
+    return m_version->fingerprint;
+}
+
+template<typename T>
+typename directed_graph_snapshot<T>::const_reference
+directed_graph_snapshot<T>::value(size_type index) const {
+    constexpr auto block_size{ versioned_directed_graph<T>::block_size };
+    return m_version->blocks[index / block_size]->values[index % block_size];
+}
+
+template<typename T>
+typename directed_graph_snapshot<T>::const_reference
+directed_graph_snapshot<T>::operator[](size_type index) const {
+    return value(index);
+}
+
+template<typename T>
+iterator_range<
+    typename directed_graph_snapshot<T>::const_iterator_adjacent_indices>
+directed_graph_snapshot<T>::out_edges(size_type index) const {
+    constexpr auto block_size{ versioned_directed_graph<T>::block_size };
+    const auto& indices{
+        m_version->blocks[index / block_size]->adjacency[index % block_size]
+    };
+    return { std::cbegin(indices), std::cend(indices) };
+}
+
+template<typename T>
+typename directed_graph_snapshot<T>::size_type
+directed_graph_snapshot<T>::index_of(const T& node_value) const {
+    if constexpr (details::hashable<T>) {
+        constexpr auto block_size{ versioned_directed_graph<T>::block_size };
+        const auto& version{ *m_version };
+        std::call_once(version.value_index_built, [&] {
+            version.value_index.reserve(version.size);
+            for (size_type i{ 0 }; i < version.slot_count; ++i) {
+                const auto& block{ *version.blocks[i / block_size] };
+                if (block.live[i % block_size]) {
+                    version.value_index.emplace(block.hashes[i % block_size],
+                                                i);
+                }
+            }
+        });
+        const auto [first, last]{ version.value_index.equal_range(
+            details::hash_value(node_value)) };
+        for (auto iter{ first }; iter != last; ++iter) {
+            if (value(iter->second) == node_value) { return iter->second; }
+        }
+    } else {
+        for (size_type i{ 0 }; i < slot_count(); ++i) {
+            if (contains(i) && value(i) == node_value) { return i; }
+        }
+    }
+    return npos;
+}
+
+template<typename T>
+versioned_directed_graph<T>::versioned_directed_graph()
+    : m_published{ std::make_shared<const version_type>() } {}
+
+template<typename T>
+template<typename A>
+versioned_directed_graph<T>::versioned_directed_graph(
+    const directed_graph<T, A>& graph)
+    : versioned_directed_graph{} {
+    for (size_type i{ 0 }; i < graph.size(); ++i) { insert(graph.value(i)); }
+    for (size_type i{ 0 }; i < graph.size(); ++i) {
+        for (auto&& target: graph.out_edges(i)) {
+            insert_edge(node_id{ i }, node_id{ target });
+        }
+    }
+    commit();
+}
+
+template<typename T>
+typename versioned_directed_graph<T>::snapshot_type
+versioned_directed_graph<T>::snapshot() const {
+    return snapshot_type{ m_published.load(std::memory_order_acquire) };
+}
+
+template<typename T>
+void versioned_directed_graph<T>::commit() {
+    auto version{ std::make_shared<version_type>() };
+    version->blocks.assign(std::begin(m_blocks), std::end(m_blocks));
+    version->size = m_size;
+    version->slot_count = m_slotCount;
+    version->fingerprint = m_fingerprint;
+    m_published.store(std::move(version), std::memory_order_release);
+    // Every block is now visible to readers, so the next change to any of
+    // them needs a fresh copy
+    ++m_generation;
+}
+
+template<typename T>
+typename versioned_directed_graph<T>::block_type&
+versioned_directed_graph<T>::mutable_block(size_type index) {
+    auto& block{ m_blocks[index / block_size] };
+    if (block->generation != m_generation) {
+        auto copy{ std::make_shared<block_type>(*block) };
+        copy->generation = m_generation;
+        block = std::move(copy);
+    }
+    return *block;
+}
+
+template<typename T>
+const typename versioned_directed_graph<T>::block_type&
+versioned_directed_graph<T>::block(size_type index) const {
+    return *m_blocks[index / block_size];
+}
+
+template<typename T>
+std::uint64_t versioned_directed_graph<T>::node_hash(size_type index) const {
+    return block(index).hashes[index % block_size];
+}
+
+template<typename T>
+std::vector<size_t>&
+versioned_directed_graph<T>::mutable_adjacency(size_type index) {
+    return mutable_block(index).adjacency[index % block_size];
+}
+
+template<typename T>
+std::vector<size_t>&
+versioned_directed_graph<T>::mutable_in_adjacency(size_type index) {
+    return mutable_block(index).in_adjacency[index % block_size];
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::insert(const T& node_value) {
+    if (index_of(node_value) != npos) { return false; }
+    const auto hash{ details::hash_value(node_value) };
+    size_type index;
+    if (!m_freeSlots.empty()) {
+        // An erased node's slot, whose edges are already gone
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        auto& block{ mutable_block(index) };
+        block.values[index % block_size] = node_value;
+        block.hashes[index % block_size] = hash;
+        block.live[index % block_size] = 1;
+    } else {
+        index = m_slotCount;
+        if (index % block_size == 0) {
+            auto block{ std::make_shared<block_type>() };
+            block->generation = m_generation;
+            block->values.reserve(block_size);
+            block->hashes.reserve(block_size);
+            block->adjacency.reserve(block_size);
+            block->in_adjacency.reserve(block_size);
+            block->live.reserve(block_size);
+            m_blocks.push_back(std::move(block));
+        }
+        auto& block{ mutable_block(index) };
+        block.values.push_back(node_value);
+        block.hashes.push_back(hash);
+        block.adjacency.emplace_back();
+        block.in_adjacency.emplace_back();
+        block.live.push_back(1);
+        ++m_slotCount;
+    }
+    m_fingerprint += details::node_fingerprint(hash);
+    if constexpr (details::hashable<T>) {
+        m_indices.emplace(node_value, index);
+    }
+    ++m_size;
+    return true;
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::erase(const T& node_value) {
+    const auto erased{ index_of(node_value) };
+    if (erased == npos) { return false; }
+    const auto erased_hash{ node_hash(erased) };
+
+    // Take the node's edges out of its own block first, as copying the
+    // block would leave references into it dangling
+    auto& own{ mutable_block(erased) };
+    const auto targets{ std::move(own.adjacency[erased % block_size]) };
+    const auto sources{ std::move(own.in_adjacency[erased % block_size]) };
+    own.adjacency[erased % block_size].clear();
+    own.in_adjacency[erased % block_size].clear();
+    own.live[erased % block_size] = 0;
+
+    // Take the node and its edges out of the fingerprint, and the edges out
+    // of the lists of the nodes at their other ends
+    m_fingerprint -= details::node_fingerprint(erased_hash);
+    for (auto target: targets) {
+        m_fingerprint -=
+            details::edge_fingerprint(erased_hash, node_hash(target));
+        if (target == erased) { continue; }
+        auto& indices{ mutable_in_adjacency(target) };
+        indices.erase(
+            std::lower_bound(std::begin(indices), std::end(indices), erased));
+    }
+    for (auto source: sources) {
+        if (source == erased) { continue; }
+        m_fingerprint -=
+            details::edge_fingerprint(node_hash(source), erased_hash);
+        auto& indices{ mutable_adjacency(source) };
+        indices.erase(
+            std::lower_bound(std::begin(indices), std::end(indices), erased));
+    }
+
+    m_freeSlots.push_back(erased);
+    --m_size;
+    if constexpr (details::hashable<T>) { m_indices.erase(node_value); }
+    return true;
+}
+
+template<typename T>
+void versioned_directed_graph<T>::compact() {
+    if (m_freeSlots.empty()) { return; }
+    std::vector<size_type> renumbered(m_slotCount, npos);
+    size_type next{ 0 };
+    for (size_type i{ 0 }; i < m_slotCount; ++i) {
+        if (block(i).live[i % block_size]) { renumbered[i] = next++; }
+    }
+
+    // Renumbering keeps the order of the nodes, so the lists stay sorted
+    const auto renumber{ [&](const std::vector<size_t>& indices) {
+        std::vector<size_t> result;
+        result.reserve(indices.size());
+        for (auto index: indices) { result.push_back(renumbered[index]); }
+        return result;
+    } };
+    std::vector<std::shared_ptr<block_type>> blocks;
+    for (size_type i{ 0 }; i < m_slotCount; ++i) {
+        const auto& from{ block(i) };
+        const auto offset{ i % block_size };
+        if (!from.live[offset]) { continue; }
+        if (renumbered[i] % block_size == 0) {
+            blocks.push_back(std::make_shared<block_type>());
+            blocks.back()->generation = m_generation;
+        }
+        auto& to{ *blocks.back() };
+        to.values.push_back(from.values[offset]);
+        to.hashes.push_back(from.hashes[offset]);
+        to.adjacency.push_back(renumber(from.adjacency[offset]));
+        to.in_adjacency.push_back(renumber(from.in_adjacency[offset]));
+        to.live.push_back(1);
+    }
+    m_blocks = std::move(blocks);
+    m_slotCount = m_size;
+    m_freeSlots.clear();
+    if constexpr (details::hashable<T>) {
+        for (auto& [value, index]: m_indices) { index = renumbered[index]; }
+    }
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::insert_edge(const T& from_node_value,
+                                              const T& to_node_value) {
+    const auto from{ index_of(from_node_value) };
+    const auto to{ index_of(to_node_value) };
+    if (from == npos || to == npos) { return false; }
+    return insert_edge(node_id{ from }, node_id{ to });
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::insert_edge(node_id from, node_id to) {
+    if (!contains(from.index) || !contains(to.index)) { return false; }
+    // Check before copying the block, so duplicate edges don't cost a copy
+    const auto& existing{
+        block(from.index).adjacency[from.index % block_size]
+    };
+    if (std::binary_search(std::begin(existing), std::end(existing),
+                           to.index)) {
+        return false;
+    }
+    auto& indices{ mutable_adjacency(from.index) };
+    indices.insert(
+        std::lower_bound(std::begin(indices), std::end(indices), to.index),
+        to.index);
+    auto& in_indices{ mutable_in_adjacency(to.index) };
+    in_indices.insert(std::lower_bound(std::begin(in_indices),
+                                       std::end(in_indices), from.index),
+                      from.index);
+    m_fingerprint +=
+        details::edge_fingerprint(node_hash(from.index), node_hash(to.index));
+    return true;
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::erase_edge(const T& from_node_value,
+                                             const T& to_node_value) {
+    const auto from{ index_of(from_node_value) };
+    const auto to{ index_of(to_node_value) };
+    if (from == npos || to == npos) { return false; }
+    return erase_edge(node_id{ from }, node_id{ to });
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::erase_edge(node_id from, node_id to) {
+    if (!contains(from.index) || !contains(to.index)) { return false; }
+    const auto& existing{
+        block(from.index).adjacency[from.index % block_size]
+    };
+    if (!std::binary_search(std::begin(existing), std::end(existing),
+                            to.index)) {
+        return false;
+    }
+    auto& indices{ mutable_adjacency(from.index) };
+    indices.erase(
+        std::lower_bound(std::begin(indices), std::end(indices), to.index));
+    auto& in_indices{ mutable_in_adjacency(to.index) };
+    in_indices.erase(std::lower_bound(std::begin(in_indices),
+                                      std::end(in_indices), from.index));
+    m_fingerprint -=
+        details::edge_fingerprint(node_hash(from.index), node_hash(to.index));
+    return true;
+}
+
+template<typename T>
+typename versioned_directed_graph<T>::size_type
+versioned_directed_graph<T>::size() const noexcept {
+    return m_size;
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::empty() const noexcept {
+    return m_size == 0;
+}
+
+template<typename T>
+typename versioned_directed_graph<T>::size_type
+versioned_directed_graph<T>::slot_count() const noexcept {
+    return m_slotCount;
+}
+
+template<typename T>
+bool versioned_directed_graph<T>::contains(size_type index) const {
+    return index < m_slotCount && block(index).live[index % block_size];
+}
+
+template<typename T>
+typename versioned_directed_graph<T>::size_type
+versioned_directed_graph<T>::index_of(const T& node_value) const {
+    if constexpr (details::hashable<T>) {
+        const auto iter{ m_indices.find(node_value) };
+        return iter == std::end(m_indices) ? npos : iter->second;
+    } else {
+        for (size_type i{ 0 }; i < m_slotCount; ++i) {
+            if (contains(i) && block(i).values[i % block_size] == node_value) {
+                return i;
+            }
+        }
+        return npos;
+    }
+}
@@ -3,9 +3,12 @@
 //
 #pragma once
 
+#include "graph_common.h"
 #include <algorithm>
+#include <cstdint>
 #include <format>
 #include <iterator>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <vector>
@@ -26,8 +29,46 @@ template<typename GraphType>
 class adjacent_weighted_nodes_iterator;
 
 namespace details {
-    // Forward declaration
-    class graph_edge;
+    class graph_edge {
+    public:
+        graph_edge(std::size_t to, double weight)
+            : m_to{ to }, m_weight{ weight } {}
+
+        auto operator<=>(const graph_edge&) const = default;
+
+        std::size_t index() const { return m_to; }
+
+        double weight() const { return m_weight; }
+
+        void set_weight(double weight) { m_weight = weight; }
+
+        void decrement() { m_to--; }
+
+    private:
+        std::size_t m_to;
+        double m_weight;
+    };
+
+    // Orders edges by target alone, and lets them be looked up by target
+    // index, so that a weight can be found and changed without a scan
+    struct graph_edge_order {
+        using is_transparent = void;
+
+        bool operator()(const graph_edge& a, const graph_edge& b) const {
+            return a.index() < b.index();
+        }
+
+        bool operator()(const graph_edge& a, std::size_t b) const {
+            return a.index() < b;
+        }
+
+        bool operator()(std::size_t a, const graph_edge& b) const {
+            return a < b.index();
+        }
+    };
+
+    // Out-edges of a node, with at most one edge to each target
+    using edge_list_type = std::set<graph_edge, graph_edge_order>;
 
     // Putting the allocation logic in a separate base class makes the
     // graph node constructor exception safe. The naive version could
@@ -116,7 +157,7 @@ namespace details {
         weighted_directed_graph<T, A>& m_graph;
 
         // Type alias for the container type used to store nodes
-        using adjacency_list_type = std::set<details::graph_edge>;
+        using adjacency_list_type = edge_list_type;
 
         // A ref to the adjacency list
         [[nodiscard]] adjacency_list_type& get_adjacent_nodes_indices();
@@ -125,19 +166,28 @@ namespace details {
         get_adjacent_nodes_indices() const;
 
         adjacency_list_type m_adjacentNodeIndices;
+
+        // Hash of the node's value, cached for fingerprint updates
+        std::uint64_t m_hash{ 0 };
+
+        // Sources of the edges into this node, kept up to date by the
+        // graph. The weights are only held by the sources' out-edges.
+        std::set<std::size_t> m_inEdges;
     };
 
     template<typename T, typename A>
     weighted_graph_node<T, A>::weighted_graph_node(
         weighted_directed_graph<T, A>& graph, const T& t, const A& allocator)
-        : m_graph{ graph }, weighted_graph_node_allocator<T, A>{ allocator } {
+        : m_graph{ graph }, weighted_graph_node_allocator<T, A>{ allocator },
+          m_hash{ details::hash_value(t) } {
         new (this->m_data) T{ t };// Placement new
     }
 
     template<typename T, typename A>
     weighted_graph_node<T, A>::weighted_graph_node(
         weighted_directed_graph<T, A>& graph, T&& t, const A& allocator)
-        : m_graph{ graph }, weighted_graph_node_allocator<T, A>{ allocator } {
+        : m_graph{ graph }, weighted_graph_node_allocator<T, A>{ allocator },
+          m_hash{ details::hash_value(t) } {
         new (this->m_data) T{ std::move(t) };
     }
 
@@ -162,7 +212,8 @@ namespace details {
         const weighted_graph_node& src)
         : weighted_graph_node_allocator<T, A>{ src.m_allocator },
           m_graph{ src.m_graph },
-          m_adjacentNodeIndices{ src.m_adjacentNodeIndices } {
+          m_adjacentNodeIndices{ src.m_adjacentNodeIndices },
+          m_hash{ src.m_hash }, m_inEdges{ src.m_inEdges } {
         new (this->m_data) T{ *(src.m_data) };
     }
 
@@ -171,15 +222,19 @@ namespace details {
         weighted_graph_node&& src) noexcept
         : weighted_graph_node_allocator<T, A>{ std::move(src) },
           m_graph{ src.m_graph },
-          m_adjacentNodeIndices{ std::move(src.m_adjacentNodeIndices) } {}
+          m_adjacentNodeIndices{ std::move(src.m_adjacentNodeIndices) },
+          m_hash{ src.m_hash }, m_inEdges{ std::move(src.m_inEdges) } {}
 
     template<typename T, typename A>
     weighted_graph_node<T, A>&
     weighted_graph_node<T, A>::operator=(const weighted_graph_node& rhs) {
+        // m_graph is a reference, and a node stays with the graph it was
+        // made for, so it isn't assigned
         if (this != &rhs) {
-            m_graph = rhs.m_graph;
             m_adjacentNodeIndices = rhs.m_adjacentNodeIndices;
-            new (this->m_data) T{ *(rhs.m_data) };
+            m_hash = rhs.m_hash;
+            m_inEdges = rhs.m_inEdges;
+            *(this->m_data) = *(rhs.m_data);
         }
         return *this;
     }
@@ -187,9 +242,11 @@ namespace details {
     template<typename T, typename A>
     weighted_graph_node<T, A>&
     weighted_graph_node<T, A>::operator=(weighted_graph_node&& rhs) noexcept {
-        m_graph = rhs.m_graph;
         m_adjacentNodeIndices = std::move(rhs.m_adjacentNodeIndices);
-        this->m_data = std::exchange(rhs.m_data, nullptr);
+        m_hash = rhs.m_hash;
+        m_inEdges = std::move(rhs.m_inEdges);
+        // Swap rather than overwrite, so that rhs cleans up the old value
+        std::swap(this->m_data, rhs.m_data);
         return *this;
     }
 
@@ -227,24 +284,6 @@ namespace details {
     weighted_graph_node<T, A>::get_adjacent_nodes_indices() const {
         return m_adjacentNodeIndices;
     }
-
-    class graph_edge {
-    public:
-        graph_edge(std::size_t to, double weight)
-            : m_to{ to }, m_weight{ weight } {}
-
-        auto operator<=>(const graph_edge&) const = default;
-
-        std::size_t index() const { return m_to; }
-
-        double weight() const { return m_weight; }
-
-        void decrement() { m_to--; }
-
-    private:
-        std::size_t m_to;
-        double m_weight;
-    };
 }// namespace details
 
 template<typename T, typename A = std::allocator<T>>
@@ -259,6 +298,10 @@ public:
     using difference_type = ptrdiff_t;
     using pair_allocator = typename std::allocator_traits<
         A>::template rebind_alloc<std::pair<T, double>>;
+    using edge_type = details::graph_edge;
+
+    // Returned by index_of when the value is not in the graph
+    static constexpr size_type npos{ static_cast<size_type>(-1) };
 
     // Constructors
     // Let the compiler default the default constructor, but make it noexcept
@@ -281,6 +324,8 @@ public:
         std::reverse_iterator<iterator_adjacent_nodes>;
     using const_reverse_iterator_adjacent_nodes =
         std::reverse_iterator<const_iterator_adjacent_nodes>;
+    using const_iterator_edges = details::edge_list_type::const_iterator;
+    using const_iterator_adjacent_indices = std::set<size_t>::const_iterator;
 
     // debug aliases
     using public_node_type = details::weighted_graph_node<T, A>;
@@ -360,35 +405,105 @@ public:
 
     iterator erase(const_iterator first, const_iterator last);
 
-    // Returns true if the edge was inserted successfully
+    // Returns true if the edge was inserted successfully. There is at most
+    // one edge between two nodes, so this returns false if the edge already
+    // exists, leaving its weight as it was.
     bool insert_edge(const T& from_node_value, const T& to_node_value,
                      double weight);
 
+    bool insert_edge(node_id from, node_id to, double weight);
+
+    // Inserts the edge, or sets its weight if it already exists. Returns
+    // false only if either node is not in the graph.
+    bool insert_or_assign_edge(const T& from_node_value,
+                               const T& to_node_value, double weight);
+
+    bool insert_or_assign_edge(node_id from, node_id to, double weight);
+
+    // Sets the weight of an existing edge in place, in O(log d) for a node
+    // with d out-edges. Returns false if there is no such edge.
+    bool set_edge_weight(const T& from_node_value, const T& to_node_value,
+                         double weight);
+
+    bool set_edge_weight(node_id from, node_id to, double weight);
+
+    // Returns true if there is an edge from from_node_value to
+    // to_node_value. The nodes are found through the hashed value index,
+    // in O(1) on average when T is hashable, and the edge in the source's
+    // own out-edges, in O(log d) for a node with d out-edges. The weights
+    // live in those sorted out-edges, so O(1) would take a second, hashed
+    // copy of every edge, kept in step on every change.
+    [[nodiscard]] bool has_edge(const T& from_node_value,
+                                const T& to_node_value) const;
+
+    [[nodiscard]] bool has_edge(node_id from, node_id to) const;
+
+    // Returns the weight of the edge, or nothing if there is no such edge.
+    // Found the same way as by has_edge.
+    [[nodiscard]] std::optional<double>
+    edge_weight(const T& from_node_value, const T& to_node_value) const;
+
+    [[nodiscard]] std::optional<double> edge_weight(node_id from,
+                                                    node_id to) const;
+
+    // Numbers of edges out of and into the node with node_value, or 0 if
+    // there is no such node. Both are stored, so these are O(1) on average
+    // when T is hashable, and the index-based overloads are always O(1).
+    [[nodiscard]] size_type out_degree(const T& node_value) const;
+
+    [[nodiscard]] size_type in_degree(const T& node_value) const;
+
+    [[nodiscard]] size_type out_degree(node_id node) const;
+
+    [[nodiscard]] size_type in_degree(node_id node) const;
+
     // Returns true if the edge is removed successfully
     bool erase_edge(const T& from_node_value, const T& to_node_value);
 
+    bool erase_edge(node_id from, node_id to);
+
     // Empties the graph
     void clear() noexcept;
 
-    // Returns a reference to the object at index. No bounds checking.
-    reference operator[](size_t index);
+    // Returns a reference to the object at index. No bounds checking. Nodes
+    // are indexed by the hashes of their values, so the non-const overload
+    // returns a node_value_reference, which assigns through set_value().
+    node_value_reference<weighted_directed_graph> operator[](size_type index);
 
-    const_reference operator[](size_t index) const;
+    const_reference operator[](size_type index) const;
 
     // Bounds-checking equivalents to operator[]
-    reference at(size_type index);
+    node_value_reference<weighted_directed_graph> at(size_type index);
 
     const_reference at(size_type index) const;
 
-    // Graphs are equal if they contain the same nodes and edges,
-    // regardless of order
+    // Replaces the value of the node at index, keeping its edges, and
+    // updates the value index and fingerprint to match. Returns false and
+    // leaves the graph unchanged if index is out of range or another node
+    // already has node_value. O(d) for a node with d edges in and out.
+    bool set_value(size_type index, T node_value);
+
+    // Graphs are equal if they contain the same nodes and edges, with the
+    // same weights, regardless of order
     bool operator==(const weighted_directed_graph& rhs) const;
 
+    // Returns the first difference found between this graph and rhs, or
+    // nothing if they are equal. Runs in O(V + E) when T is hashable.
+    [[nodiscard]] std::optional<graph_difference>
+    first_difference(const weighted_directed_graph& rhs) const;
+
     bool operator!=(const weighted_directed_graph& rhs) const;
 
     // Swaps all nodes between this graph and other_graph
     void swap(weighted_directed_graph& other_graph) noexcept;
 
+    // Order-independent hash of the graph's node values and edges, kept up
+    // to date by every modification. Equal graphs have equal fingerprints,
+    // so differing fingerprints mean the graphs differ. Edge weights are
+    // included. If T has no std::hash specialisation, only the weights and
+    // the numbers of nodes and edges are reflected.
+    [[nodiscard]] std::uint64_t fingerprint() const noexcept;
+
     [[nodiscard]] size_type size() const noexcept;
 
     [[nodiscard]] size_type max_size() const noexcept;
@@ -403,6 +518,35 @@ public:
     [[nodiscard]] std::set<std::pair<T, double>, std::less<>, pair_allocator>
     get_adjacent_nodes_values_and_weights(const T& node_value) const;
 
+    // View over the nodes connected to the node with node_value, read
+    // straight from the adjacency list without copying. Each element holds
+    // a reference to the neighbouring node's value and the edge weight. The
+    // view is empty if node_value is not in the graph.
+    [[nodiscard]] iterator_range<const_iterator_adjacent_nodes>
+    adjacent_nodes(const T& node_value) const;
+
+    // Index-based access, for algorithms that work on dense node ids
+    // rather than values. Node indices are positions in the graph, as used
+    // by operator[], and are shifted down by erasing an earlier node.
+
+    // View over the raw out-edges of the node at index, ordered by target
+    // index. No bounds checking.
+    [[nodiscard]] iterator_range<const_iterator_edges>
+    out_edges(size_type index) const;
+
+    // View over the sources of the edges into the node at index, in
+    // ascending order, for searching backwards. Each edge's weight is
+    // found with edge_weight(). No bounds checking.
+    [[nodiscard]] iterator_range<const_iterator_adjacent_indices>
+    in_edges(size_type index) const;
+
+    // Returns the value of the node at index. No bounds checking.
+    [[nodiscard]] const_reference value(size_type index) const;
+
+    // Returns the index of the node with node_value, or npos if there is no
+    // such node
+    [[nodiscard]] size_type index_of(const T& node_value) const;
+
 private:
     friend class details::weighted_graph_node<T, A>;
     friend class const_graph_iterator<weighted_directed_graph>;
@@ -413,6 +557,17 @@ private:
 
     nodes_container_type m_nodes;
     A m_allocator;
+    std::uint64_t m_fingerprint{ 0 };
+
+    // Hashed lookup by node value, kept in step with m_nodes
+    details::value_index_type<T> m_valueIndex;
+
+    // Adds the last node in m_nodes to the value index
+    void index_last_node();
+
+    // Rebuilds the value index and the in-edges from scratch, after nodes
+    // have been erased and the remaining ones renumbered
+    void rebuild_indices();
 
     // Returns an iterator at the searched-for value, or the end iterator
     // if the value is not found.
@@ -428,6 +583,16 @@ private:
     void remove_all_links_to(
         typename nodes_container_type::const_iterator node_iter);
 
+    // Contribution of the edge from node to the fingerprint
+    [[nodiscard]] std::uint64_t
+    edge_fingerprint(const details::weighted_graph_node<T, A>& node,
+                     const edge_type& edge) const;
+
+    // Replaces the weight of the edge at position in the out-edges of the
+    // node at index from
+    void assign_edge_weight(size_type from, const_iterator_edges position,
+                            double weight);
+
     [[nodiscard]] std::set<T, std::less<>, A> get_adjacent_nodes_values(
         const typename details::weighted_graph_node<T, A>::adjacency_list_type&
             indices) const;
@@ -454,9 +619,21 @@ weighted_directed_graph<T, A>::weighted_directed_graph(
 template<typename T, typename A>
 typename weighted_directed_graph<T, A>::nodes_container_type::iterator
 weighted_directed_graph<T, A>::findNode(const T& node_value) {
-    return std::find_if(
-        std::begin(m_nodes), std::end(m_nodes),
-        [&node_value](const auto& node) { return node.value() == node_value; });
+    if constexpr (details::hashable<T>) {
+        const auto [first, last]{ m_valueIndex.equal_range(
+            details::hash_value(node_value)) };
+        for (auto iter{ first }; iter != last; ++iter) {
+            if (m_nodes[iter->second].value() == node_value) {
+                return std::begin(m_nodes) + iter->second;
+            }
+        }
+        return std::end(m_nodes);
+    } else {
+        return std::find_if(std::begin(m_nodes), std::end(m_nodes),
+                            [&node_value](const auto& node) {
+                                return node.value() == node_value;
+                            });
+    }
 }
 
 template<typename T, typename A>
@@ -475,9 +652,36 @@ weighted_directed_graph<T, A>::insert(T&& node_value) {
         return { iterator{ iter, this }, false };
     }
     m_nodes.emplace_back(*this, std::move(node_value), m_allocator);
+    m_fingerprint += details::node_fingerprint(m_nodes.back().m_hash);
+    index_last_node();
     return { iterator{ --std::end(m_nodes), this }, true };
 }
 
+template<typename T, typename A>
+void weighted_directed_graph<T, A>::index_last_node() {
+    if constexpr (details::hashable<T>) {
+        m_valueIndex.emplace(m_nodes.back().m_hash, m_nodes.size() - 1);
+    }
+}
+
+template<typename T, typename A>
+void weighted_directed_graph<T, A>::rebuild_indices() {
+    if constexpr (details::hashable<T>) {
+        m_valueIndex.clear();
+        for (size_type index{ 0 }; index < m_nodes.size(); ++index) {
+            m_valueIndex.emplace(m_nodes[index].m_hash, index);
+        }
+    }
+    for (auto&& node: m_nodes) { node.m_inEdges.clear(); }
+    for (size_type from{ 0 }; from < m_nodes.size(); ++from) {
+        for (auto&& edge: m_nodes[from].get_adjacent_nodes_indices()) {
+            // Sources come in ascending order, so append at the end
+            auto& in_edges{ m_nodes[edge.index()].m_inEdges };
+            in_edges.emplace_hint(std::end(in_edges), from);
+        }
+    }
+}
+
 template<typename T, typename A>
 std::pair<typename weighted_directed_graph<T, A>::iterator, bool>
 weighted_directed_graph<T, A>::insert(const T& node_value) {
@@ -514,10 +718,162 @@ bool weighted_directed_graph<T, A>::insert_edge(const T& from_node_value,
     const auto from{ findNode(from_node_value) };
     const auto to{ findNode(to_node_value) };
     if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
-    const size_t to_index{ get_index_of_node(to) };
-    return from->get_adjacent_nodes_indices()
-        .insert({ to_index, weight })
-        .second;
+    return insert_edge(node_id{ get_index_of_node(from) },
+                       node_id{ get_index_of_node(to) }, weight);
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::insert_edge(node_id from, node_id to,
+                                                double weight) {
+    if (from.index >= m_nodes.size() || to.index >= m_nodes.size()) {
+        return false;
+    }
+    auto& from_node{ m_nodes[from.index] };
+    const auto [edge, inserted]{ from_node.get_adjacent_nodes_indices().insert(
+        { to.index, weight }) };
+    if (!inserted) { return false; }
+    m_nodes[to.index].m_inEdges.insert(from.index);
+    m_fingerprint += edge_fingerprint(from_node, *edge);
+    return true;
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::insert_or_assign_edge(
+    const T& from_node_value, const T& to_node_value, double weight) {
+    const auto from{ findNode(from_node_value) };
+    const auto to{ findNode(to_node_value) };
+    if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
+    return insert_or_assign_edge(node_id{ get_index_of_node(from) },
+                                 node_id{ get_index_of_node(to) }, weight);
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::insert_or_assign_edge(node_id from,
+                                                          node_id to,
+                                                          double weight) {
+    if (from.index >= m_nodes.size() || to.index >= m_nodes.size()) {
+        return false;
+    }
+    auto& from_node{ m_nodes[from.index] };
+    const auto [edge, inserted]{ from_node.get_adjacent_nodes_indices().insert(
+        { to.index, weight }) };
+    if (inserted) {
+        m_nodes[to.index].m_inEdges.insert(from.index);
+        m_fingerprint += edge_fingerprint(from_node, *edge);
+    } else {
+        assign_edge_weight(from.index, edge, weight);
+    }
+    return true;
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::set_edge_weight(const T& from_node_value,
+                                                    const T& to_node_value,
+                                                    double weight) {
+    const auto from{ findNode(from_node_value) };
+    const auto to{ findNode(to_node_value) };
+    if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
+    return set_edge_weight(node_id{ get_index_of_node(from) },
+                           node_id{ get_index_of_node(to) }, weight);
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::set_edge_weight(node_id from, node_id to,
+                                                    double weight) {
+    if (from.index >= m_nodes.size()) { return false; }
+    auto& from_node{ m_nodes[from.index] };
+    const auto edge{ from_node.get_adjacent_nodes_indices().find(to.index) };
+    if (edge == std::end(from_node.get_adjacent_nodes_indices())) {
+        return false;
+    }
+    assign_edge_weight(from.index, edge, weight);
+    return true;
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::has_edge(const T& from_node_value,
+                                             const T& to_node_value) const {
+    return edge_weight(from_node_value, to_node_value).has_value();
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::has_edge(node_id from, node_id to) const {
+    return edge_weight(from, to).has_value();
+}
+
+template<typename T, typename A>
+std::optional<double>
+weighted_directed_graph<T, A>::edge_weight(const T& from_node_value,
+                                           const T& to_node_value) const {
+    const auto from{ findNode(from_node_value) };
+    const auto to{ findNode(to_node_value) };
+    if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return {}; }
+    return edge_weight(node_id{ get_index_of_node(from) },
+                       node_id{ get_index_of_node(to) });
+}
+
+template<typename T, typename A>
+std::optional<double>
+weighted_directed_graph<T, A>::edge_weight(node_id from, node_id to) const {
+    if (from.index >= m_nodes.size()) { return {}; }
+    const auto& edges{ m_nodes[from.index].get_adjacent_nodes_indices() };
+    const auto edge{ edges.find(to.index) };
+    if (edge == std::end(edges)) { return {}; }
+    return edge->weight();
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::size_type
+weighted_directed_graph<T, A>::out_degree(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return 0; }
+    return iter->get_adjacent_nodes_indices().size();
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::size_type
+weighted_directed_graph<T, A>::in_degree(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return 0; }
+    return iter->m_inEdges.size();
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::size_type
+weighted_directed_graph<T, A>::out_degree(node_id node) const {
+    if (node.index >= m_nodes.size()) { return 0; }
+    return m_nodes[node.index].get_adjacent_nodes_indices().size();
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::size_type
+weighted_directed_graph<T, A>::in_degree(node_id node) const {
+    if (node.index >= m_nodes.size()) { return 0; }
+    return m_nodes[node.index].m_inEdges.size();
+}
+
+template<typename T, typename A>
+std::uint64_t weighted_directed_graph<T, A>::edge_fingerprint(
+    const details::weighted_graph_node<T, A>& node,
+    const edge_type& edge) const {
+    return details::weighted_edge_fingerprint(
+        node.m_hash, m_nodes[edge.index()].m_hash, edge.weight());
+}
+
+template<typename T, typename A>
+void weighted_directed_graph<T, A>::assign_edge_weight(
+    size_type from, const_iterator_edges position, double weight) {
+    auto& node{ m_nodes[from] };
+    auto& edges{ node.get_adjacent_nodes_indices() };
+    m_fingerprint -= edge_fingerprint(node, *position);
+    // The weight isn't part of the ordering, so an edge can be taken out,
+    // changed and put straight back without any allocation. The out-edge
+    // holds the only copy of the weight.
+    const auto next{ std::next(position) };
+    auto handle{ edges.extract(position) };
+    handle.value().set_weight(weight);
+    const auto edge{ edges.insert(next, std::move(handle)) };
+    m_fingerprint += edge_fingerprint(node, *edge);
 }
 
 template<typename T, typename A>
@@ -532,14 +888,23 @@ void weighted_directed_graph<T, A>::remove_all_links_to(
     typename nodes_container_type::const_iterator node_iter) {
     const size_t node_index{ get_index_of_node(node_iter) };
 
+    // Take the node and its out-edges out of the fingerprint
+    m_fingerprint -= details::node_fingerprint(node_iter->m_hash);
+    for (auto&& edge: node_iter->get_adjacent_nodes_indices()) {
+        m_fingerprint -= edge_fingerprint(*node_iter, edge);
+    }
+
     // Iterate over all adjacency lists of all nodes
     for (auto&& node: m_nodes) {
         auto& adjacencyIndices{ node.get_adjacent_nodes_indices() };
         // Remove references from to-be-deleted node
-        std::erase_if(adjacencyIndices, [node_index](auto const& e) {
-            return e.index() == node_index;
-        });
-        //adjacencyIndices.erase(node_index);
+        const auto edge{ adjacencyIndices.find(node_index) };
+        if (edge != std::end(adjacencyIndices)) {
+            if (&node != &*node_iter) {
+                m_fingerprint -= edge_fingerprint(node, *edge);
+            }
+            adjacencyIndices.erase(edge);
+        }
         // Modify adjacency indices to account for deletion
         // Some inefficiency, as data is converted to a vector,
         // indices are adjusted, and the set is wiped and rebuilt
@@ -561,6 +926,7 @@ bool weighted_directed_graph<T, A>::erase(const T& node_value) {
     if (iter == std::end(m_nodes)) { return false; }
     remove_all_links_to(iter);
     m_nodes.erase(iter);
+    rebuild_indices();
     return true;
 }
 
@@ -571,20 +937,26 @@ weighted_directed_graph<T, A>::erase(const_iterator pos) {
         return iterator{ std::end(m_nodes), this };
     }
     remove_all_links_to(pos.m_nodeIterator);
-    return iterator{ m_nodes.erase(pos.m_nodeIterator), this };
+    const auto next{ m_nodes.erase(pos.m_nodeIterator) };
+    rebuild_indices();
+    return iterator{ next, this };
 }
 
 template<typename T, typename A>
 typename weighted_directed_graph<T, A>::iterator
 weighted_directed_graph<T, A>::erase(const_iterator first,
                                      const_iterator last) {
-    for (auto iter{ first }; iter != last; ++iter) {
-        if (iter.m_nodeIterator != std::end(m_nodes)) {
-            remove_all_links_to(iter.m_nodeIterator);
-        }
+    // Erase back to front, so that removing each node only shifts the
+    // indices of nodes that have already been dealt with.
+    const auto first_index{ get_index_of_node(first.m_nodeIterator) };
+    for (auto index{ get_index_of_node(last.m_nodeIterator) };
+         index > first_index; --index) {
+        const auto node_iter{ std::begin(m_nodes) + (index - 1) };
+        remove_all_links_to(node_iter);
+        m_nodes.erase(node_iter);
     }
-    return iterator{ m_nodes.erase(first.m_nodeIterator, last.m_nodeIterator),
-                     this };
+    rebuild_indices();
+    return iterator{ std::begin(m_nodes) + first_index, this };
 }
 
 template<typename T, typename A>
@@ -593,15 +965,30 @@ bool weighted_directed_graph<T, A>::erase_edge(const T& from_node_value,
     const auto from{ findNode(from_node_value) };
     const auto to{ findNode(to_node_value) };
     if (from == std::end(m_nodes) || to == std::end(m_nodes)) { return false; }
-    const size_t to_index{ get_index_of_node(to) };
-    std::erase_if(from->get_adjacent_nodes_indices(),
-                  [to_index](auto const& e) { return e.index() == to_index; });
+    return erase_edge(node_id{ get_index_of_node(from) },
+                      node_id{ get_index_of_node(to) });
+}
+
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::erase_edge(node_id from, node_id to) {
+    if (from.index >= m_nodes.size() || to.index >= m_nodes.size()) {
+        return false;
+    }
+    auto& from_node{ m_nodes[from.index] };
+    auto& edges{ from_node.get_adjacent_nodes_indices() };
+    const auto edge{ edges.find(to.index) };
+    if (edge == std::end(edges)) { return false; }
+    m_fingerprint -= edge_fingerprint(from_node, *edge);
+    edges.erase(edge);
+    m_nodes[to.index].m_inEdges.erase(from.index);
     return true;
 }
 
 template<typename T, typename A>
 void weighted_directed_graph<T, A>::clear() noexcept {
     m_nodes.clear();
+    m_fingerprint = 0;
+    if constexpr (details::hashable<T>) { m_valueIndex.clear(); }
 }
 
 template<typename T, typename A>
@@ -610,12 +997,19 @@ void weighted_directed_graph<T, A>::swap(
     using std::swap;
     m_nodes.swap(other_graph.m_nodes);
     swap(m_allocator, other_graph.m_allocator);
+    swap(m_fingerprint, other_graph.m_fingerprint);
+    swap(m_valueIndex, other_graph.m_valueIndex);
 }
 
 template<typename T, typename A>
-typename weighted_directed_graph<T, A>::reference
-weighted_directed_graph<T, A>::operator[](size_t index) {
-    return m_nodes[index].value();
+std::uint64_t weighted_directed_graph<T, A>::fingerprint() const noexcept {
+    return m_fingerprint;
+}
+
+template<typename T, typename A>
+node_value_reference<weighted_directed_graph<T, A>>
+weighted_directed_graph<T, A>::operator[](size_type index) {
+    return { *this, index };
 }
 
 template<typename T, typename A>
@@ -625,9 +1019,11 @@ weighted_directed_graph<T, A>::operator[](size_type index) const {
 }
 
 template<typename T, typename A>
-typename weighted_directed_graph<T, A>::reference
+node_value_reference<weighted_directed_graph<T, A>>
 weighted_directed_graph<T, A>::at(size_type index) {
-    return m_nodes.at(index).value();
+    // Throws std::out_of_range like the const overload
+    static_cast<void>(m_nodes.at(index));
+    return { *this, index };
 }
 
 template<typename T, typename A>
@@ -638,22 +1034,60 @@ weighted_directed_graph<T, A>::at(
 }
 
 template<typename T, typename A>
-bool weighted_directed_graph<T, A>::operator==(
-    const weighted_directed_graph& rhs) const {
-    if (m_nodes.size() != rhs.m_nodes.size()) { return false; }
+bool weighted_directed_graph<T, A>::set_value(size_type index, T node_value) {
+    if (index >= m_nodes.size()) { return false; }
+    const auto existing{ findNode(node_value) };
+    if (existing != std::end(m_nodes)) {
+        return get_index_of_node(existing) == index;
+    }
 
-    for (auto&& node: m_nodes) {
-        const auto rhsNodeIter{ rhs.findNode(node.value()) };
-        if (rhsNodeIter == std::end(rhs.m_nodes)) { return false; }
-        const auto adjacent_values_lhs{ get_adjacent_nodes_values(
-            node.get_adjacent_nodes_indices()) };
-        const auto adjacent_values_rhs{ rhs.get_adjacent_nodes_values(
-            rhsNodeIter->get_adjacent_nodes_indices()) };
-        if (adjacent_values_lhs != adjacent_values_rhs) { return false; }
+    // Every edge at the node is hashed with its value, so all of them
+    // leave the fingerprint and come back with the new hash. A loop is
+    // among the out-edges, so it is left out of the in-edges.
+    auto& node{ m_nodes[index] };
+    const auto contribution{ [&] {
+        auto sum{ details::node_fingerprint(node.m_hash) };
+        for (auto&& edge: node.get_adjacent_nodes_indices()) {
+            sum += edge_fingerprint(node, edge);
+        }
+        for (auto from: node.m_inEdges) {
+            if (from == index) { continue; }
+            const auto& source{ m_nodes[from] };
+            sum += edge_fingerprint(
+                source, *source.get_adjacent_nodes_indices().find(index));
+        }
+        return sum;
+    } };
+    const auto old_contribution{ contribution() };
+    const auto old_hash{ node.m_hash };
+    node.value() = std::move(node_value);
+    node.m_hash = details::hash_value(node.value());
+    m_fingerprint += contribution() - old_contribution;
+
+    if constexpr (details::hashable<T>) {
+        const auto [first, last]{ m_valueIndex.equal_range(old_hash) };
+        m_valueIndex.erase(std::find_if(first, last, [index](auto&& entry) {
+            return entry.second == index;
+        }));
+        m_valueIndex.emplace(node.m_hash, index);
     }
     return true;
 }
 
+template<typename T, typename A>
+bool weighted_directed_graph<T, A>::operator==(
+    const weighted_directed_graph& rhs) const {
+    // Differing fingerprints are a cheap way to rule out equality
+    if (m_fingerprint != rhs.m_fingerprint) { return false; }
+    return !first_difference(rhs);
+}
+
+template<typename T, typename A>
+std::optional<graph_difference> weighted_directed_graph<T, A>::first_difference(
+    const weighted_directed_graph& rhs) const {
+    return details::first_difference(*this, rhs);
+}
+
 template<typename T, typename A>
 std::set<T, std::less<>, A>
 weighted_directed_graph<T, A>::get_adjacent_nodes_values(
@@ -718,6 +1152,46 @@ weighted_directed_graph<T, A>::get_adjacent_nodes_values_and_weights(
         iter->get_adjacent_nodes_indices());
 }
 
+template<typename T, typename A>
+iterator_range<
+    typename weighted_directed_graph<T, A>::const_iterator_adjacent_nodes>
+weighted_directed_graph<T, A>::adjacent_nodes(const T& node_value) const {
+    auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return {}; }
+    const auto& edges{ iter->get_adjacent_nodes_indices() };
+    return { const_iterator_adjacent_nodes{ std::cbegin(edges), this },
+             const_iterator_adjacent_nodes{ std::cend(edges), this } };
+}
+
+template<typename T, typename A>
+iterator_range<typename weighted_directed_graph<T, A>::const_iterator_edges>
+weighted_directed_graph<T, A>::out_edges(size_type index) const {
+    const auto& edges{ m_nodes[index].get_adjacent_nodes_indices() };
+    return { std::cbegin(edges), std::cend(edges) };
+}
+
+template<typename T, typename A>
+iterator_range<
+    typename weighted_directed_graph<T, A>::const_iterator_adjacent_indices>
+weighted_directed_graph<T, A>::in_edges(size_type index) const {
+    const auto& sources{ m_nodes[index].m_inEdges };
+    return { std::cbegin(sources), std::cend(sources) };
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::const_reference
+weighted_directed_graph<T, A>::value(size_type index) const {
+    return m_nodes[index].value();
+}
+
+template<typename T, typename A>
+typename weighted_directed_graph<T, A>::size_type
+weighted_directed_graph<T, A>::index_of(const T& node_value) const {
+    const auto iter{ findNode(node_value) };
+    if (iter == std::end(m_nodes)) { return npos; }
+    return get_index_of_node(iter);
+}
+
 template<typename T, typename A>
 typename weighted_directed_graph<T, A>::size_type
 weighted_directed_graph<T, A>::size() const noexcept {
@@ -1113,7 +1587,7 @@ public:
     using iterator_category = std::bidirectional_iterator_tag;
     using pointer = const ptr_value_type;
     using reference = const ref_value_type;
-    using iterator_type = std::set<details::graph_edge>::const_iterator;
+    using iterator_type = details::edge_list_type::const_iterator;
 
     // Bidirectional iterators need to provide a default constructor
     const_adjacent_weighted_nodes_iterator() = default;
@@ -1238,7 +1712,7 @@ public:
     using iterator_category = std::bidirectional_iterator_tag;
     using pointer = value_type*;
     using reference = value_type&;
-    using iterator_type = std::set<details::graph_edge>::iterator;
+    using iterator_type = details::edge_list_type::iterator;
 
     adjacent_weighted_nodes_iterator() = default;
 